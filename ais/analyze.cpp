@@ -0,0 +1,73 @@
+#include "ais/connect4Analysis.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+// Usage: analyze [--playouts=N] [--usec=N] [--threads=N] [file]
+//
+// Reads positions from `file`, or stdin, and prints one JSON line per position
+// as soon as it has been analyzed. Throughput goes to stderr at the end.
+int main(int argc, char **argv) {
+  ais::conn4::AnalysisOptions options;
+  options.numThreads = std::thread::hardware_concurrency();
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--playouts=", 11) == 0) {
+      options.playouts = strtoull(argv[i] + 11, nullptr, 10);
+    } else if (strncmp(argv[i], "--usec=", 7) == 0) {
+      options.duration = std::chrono::microseconds(atoll(argv[i] + 7));
+    } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+      options.numThreads = atoi(argv[i] + 10);
+    } else if (argv[i][0] != '-' && !path) {
+      path = argv[i];
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--playouts=N] [--usec=N] [--threads=N] [file]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (options.playouts == 0 && options.duration.count() == 0) {
+    options.playouts = 10000;
+  }
+  options.numThreads = std::max(options.numThreads, 1);
+
+  std::vector<ais::conn4::Position> positions;
+  std::string error;
+  bool ok;
+  if (path) {
+    std::ifstream in(path);
+    if (!in) {
+      fprintf(stderr, "Can't open %s\n", path);
+      return 1;
+    }
+    ok = ais::conn4::readPositions(in, &positions, &error);
+  } else {
+    ok = ais::conn4::readPositions(std::cin, &positions, &error);
+  }
+  if (!ok) {
+    fprintf(stderr, "%s: %s\n", path ? path : "stdin", error.c_str());
+    return 1;
+  }
+
+  auto stats = ais::conn4::analyzePositions(
+      positions, options,
+      [&](size_t index, const ais::conn4::SearchResult &result) {
+        auto json =
+            ais::conn4::analysisToJson(index, positions[index], result);
+        printf("%s\n", json.c_str());
+        fflush(stdout);
+      });
+
+  fprintf(stderr,
+          "%zu positions in %.3fs on %d threads: %.1f positions/s, %.0f "
+          "playouts/s\n",
+          stats.positions, stats.seconds, options.numThreads,
+          stats.positions / stats.seconds, stats.playouts / stats.seconds);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace ais {
+
+// Bounded lock-free multi-producer multi-consumer queue. Each cell carries a
+// sequence number that tells producers and consumers whose turn it is, so
+// tryPush and tryPop only contend on a single atomic each.
+template <typename T> class BoundedQueue {
+public:
+  // The capacity is rounded up to a power of two.
+  explicit BoundedQueue(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+    mask_ = size - 1;
+    cells_ = std::make_unique<Cell[]>(size);
+    for (size_t i = 0; i < size; i++) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns false if the queue is full.
+  bool tryPush(const T &value) {
+    size_t pos = pushPos_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell &cell = cells_[pos & mask_];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (pushPos_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = pushPos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Returns false if the queue is empty.
+  bool tryPop(T *value) {
+    size_t pos = popPos_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell &cell = cells_[pos & mask_];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (popPos_.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed)) {
+          *value = cell.value;
+          cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = popPos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(64) std::atomic<size_t> pushPos_{0};
+  alignas(64) std::atomic<size_t> popPos_{0};
+};
+
+} // namespace ais
@@ -1,12 +1,21 @@
 #include "ais/connect4AI.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <queue>
 #include <random>
 #include <thread>
+#include <unordered_set>
+
+#include "ais/connect4Playout.h"
+#include "ais/connect4Policy.h"
 
 namespace ais::conn4 {
 
-Board::Board(std::string str) {
-  int row = 5;
+template <int Rows, int Cols, int InARow>
+BasicBoard<Rows, Cols, InARow>::BasicBoard(std::string str) {
+  int row = kRows - 1;
   int col = 0;
   int charIdx = 0;
   do {
@@ -27,7 +36,8 @@ Board::Board(std::string str) {
   assert(boardIsLegal());
 }
 
-std::string Board::debugString() const {
+template <int Rows, int Cols, int InARow>
+std::string BasicBoard<Rows, Cols, InARow>::debugString() const {
   std::string b;
   for (int row = kRows - 1; row >= 0; row--) {
     for (int col = 0; col < kCols; col++) {
@@ -49,72 +59,76 @@ std::string Board::debugString() const {
   return b;
 }
 
-Board::Player Board::getPlayer(Spot spot) const {
-  for (auto value : std::to_array({Board::Player::One, Board::Player::Two})) {
-    if (1 & ((board_[bIdx(value)] >> (8 * spot.col)) >> spot.row)) {
+template <int Rows, int Cols, int InARow>
+BoardBase::Player BasicBoard<Rows, Cols, InARow>::getPlayer(Spot spot) const {
+  for (auto value : std::to_array({Player::One, Player::Two})) {
+    if (1 & (board_[bIdx(value)] >> (kColStride * spot.col + spot.row))) {
       return value;
     }
   }
   return Player::None;
 }
 
-void Board::move(Spot spot, Player value) {
-  board_[bIdx(value)] |= (1ULL << spot.row) << (8 * spot.col);
+template <int Rows, int Cols, int InARow>
+void BasicBoard<Rows, Cols, InARow>::move(Spot spot, Player value) {
+  board_[bIdx(value)] |= Bits{1} << (kColStride * spot.col + spot.row);
 }
 
-Board::Player Board::winner() const {
-  for (auto value : std::to_array({Board::Player::One, Board::Player::Two})) {
-    uint64_t b = board_[bIdx(value)];
+template <int Rows, int Cols, int InARow>
+BoardBase::Player BasicBoard<Rows, Cols, InARow>::winner() const {
+  for (auto value : std::to_array({Player::One, Player::Two})) {
+    Bits b = board_[bIdx(value)];
 
-    uint64_t columnWin = b & (b >> 1) & (b >> 2) & (b >> 3);
-    if (columnWin != 0) {
+    if (hasLine(b, /*shift=*/1)) { // Column
       return value;
     }
 
-    uint64_t rowWin = b & (b >> 8) & (b >> 16) & (b >> 24);
-    if (rowWin != 0) {
+    if (hasLine(b, /*shift=*/kColStride)) { // Row
       return value;
     }
 
-    uint64_t forwardDiagWin = b & (b >> 9) & (b >> 18) & (b >> 27);
-    if (forwardDiagWin != 0) {
+    if (hasLine(b, /*shift=*/kColStride + 1)) { // Forward diagonal
       return value;
     }
 
-    uint64_t backDiagWin = b & (b >> 7) & (b >> 14) & (b >> 21);
-    if (backDiagWin != 0) {
+    if (hasLine(b, /*shift=*/kColStride - 1)) { // Back diagonal
       return value;
     }
   }
 
-  if ((board_[0] | board_[1]) == 0x3f3f3f3f3f3f3fULL) {
+  if ((board_[0] | board_[1]) == kBoardMask) {
     return Player::Draw;
   }
 
   return Player::None;
 }
 
-Board::LegalMoves Board::legalMoves() const {
+template <int Rows, int Cols, int InARow>
+typename BasicBoard<Rows, Cols, InARow>::LegalMoves
+BasicBoard<Rows, Cols, InARow>::legalMoves() const {
   LegalMoves legal;
 
-  uint64_t b = board_[0] | board_[1];
+  Bits b = board_[0] | board_[1];
 
   for (int col = 0; col < kCols; col++) {
-    int colVal = (b >> (8 * col)) & kColMask;
-    legal.legalRowInCol[col] = __builtin_ctz(~colVal);
+    uint64_t colVal =
+        static_cast<uint64_t>(b >> (kColStride * col)) & kColMask;
+    legal.legalRowInCol[col] = __builtin_ctzll(~colVal);
   }
 
   return legal;
 }
 
-Board::Spot Board::getWinningMove(Player player) const {
+template <int Rows, int Cols, int InARow>
+BoardBase::Spot
+BasicBoard<Rows, Cols, InARow>::getWinningMove(Player player) const {
   auto legal = legalMoves();
   for (int col = 0; col < kCols; col++) {
     int row = legal.legalRowInCol[col];
     if (row == LegalMoves::kIllegal) {
       continue;
     }
-    Board b(*this);
+    BasicBoard b(*this);
     Spot spot({.row = row, .col = col});
     b.move(spot, player);
     if (b.winner() == player) {
@@ -125,109 +139,252 @@ Board::Spot Board::getWinningMove(Player player) const {
   return kIllegalSpot;
 }
 
-Board::Player Board::nextPlayer() const {
-  uint64_t b = board_[0] | board_[1];
-  return static_cast<Board::Player>(__builtin_popcountll(b) % 2);
+template <int Rows, int Cols, int InARow>
+BoardBase::Player BasicBoard<Rows, Cols, InARow>::nextPlayer() const {
+  Bits b = board_[0] | board_[1];
+  return static_cast<Player>(popcount(b) % 2);
 }
 
-bool Board::boardIsLegal() const {
-  int movesOne = __builtin_popcountll(board_[0]);
-  int movesTwo = __builtin_popcountll(board_[1]);
+template <int Rows, int Cols, int InARow>
+bool BasicBoard<Rows, Cols, InARow>::boardIsLegal() const {
+  int movesOne = popcount(board_[0]);
+  int movesTwo = popcount(board_[1]);
 
   if (movesOne != movesTwo && movesOne != movesTwo + 1) {
     return false;
   }
 
-  uint64_t merged = board_[0] | board_[1];
-  if (((merged + 0x1010101010101ULL) & merged) != 0) {
+  Bits merged = board_[0] | board_[1];
+  if (((merged + kBottomMask) & merged) != 0) {
     return false;
   }
 
-  if (merged & ~0x3f3f3f3f3f3f3fULL) {
+  if (merged & ~kBoardMask) {
     return false;
   }
 
   return true;
 }
 
-double State::WinProb::prob(Board::Player playerToMove) const {
+template <typename BoardT, typename PolicyT>
+double BasicState<BoardT, PolicyT>::WinProb::prob(Player playerToMove) const {
   uint64_t heuristic = heuristic_.load(std::memory_order_relaxed);
   auto winner = solvedWinnerImpl(heuristic);
-  if (winner != Board::Player::None) {
+  if (winner != Player::None) {
     return (winner == playerToMove) ? 1.0 : 0.0;
   }
   double p =
       static_cast<double>(heuristic >> 32) / static_cast<uint32_t>(heuristic);
   assert(p <= 1.0);
-  return (playerToMove == Board::Player::One) ? 1.0 - p : p;
+  return (playerToMove == Player::One) ? 1.0 - p : p;
 }
 
-void State::WinProb::recordTrial(Board::Player winner) {
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::WinProb::recordTrial(Player winner) {
   uint64_t increment = 1;
-  if (winner == Board::Player::Two) {
+  if (winner == Player::Two) {
     increment += 1ULL << 32;
   }
+
+  if (shards_ && !shards_->closed.load()) {
+    auto &shard = shards_->shards[shardIdx()].heuristic;
+    uint64_t pending = shard.fetch_add(increment) + increment;
+    // A flushShards that ran meanwhile may have missed this trial. Both sides
+    // are sequentially consistent, so either it saw the trial or this sees
+    // the shards closed and folds the shard in itself.
+    if (static_cast<uint32_t>(pending) < kShardFlushTrials &&
+        !shards_->closed.load()) {
+      return;
+    }
+    // Another thread mapped to the same shard may have flushed it already.
+    increment = shard.exchange(0);
+    if (increment == 0) {
+      return;
+    }
+  }
+
   heuristic_.fetch_add(increment, std::memory_order_relaxed);
 }
 
-void State::WinProb::markSolved(Board::Player winner) {
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::WinProb::enableSharding() {
+  shards_ = std::make_unique<Shards>();
+}
+
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::WinProb::flushShards() {
+  if (!shards_) {
+    return;
+  }
+  shards_->closed.store(true);
+  uint64_t pending = 0;
+  for (auto &shard : shards_->shards) {
+    pending += shard.heuristic.exchange(0);
+  }
+  if (pending) {
+    heuristic_.fetch_add(pending, std::memory_order_relaxed);
+  }
+}
+
+template <typename BoardT, typename PolicyT>
+/*static*/
+int BasicState<BoardT, PolicyT>::WinProb::shardIdx() {
+  static std::atomic<int> nextIdx{0};
+  thread_local int idx =
+      nextIdx.fetch_add(1, std::memory_order_relaxed) % kNumShards;
+  return idx;
+}
+
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::WinProb::markSolved(Player winner) {
   // Use the high two bits to mark solved situations so that if other threads
   // come in and record Monte Carlo trials, they won't overwrite the flags.
-  uint64_t v = (winner == Board::Player::One) ? (2ULL << 62) : (3ULL << 62);
+  uint64_t v = (winner == Player::One) ? (2ULL << 62) : (3ULL << 62);
+  // Empty the shards first, so that a flush can't later add stale trials to
+  // the solved value.
+  flushShards();
   heuristic_.store(v, std::memory_order_relaxed);
 }
 
-uint32_t State::WinProb::numTrials() const {
+template <typename BoardT, typename PolicyT>
+uint32_t BasicState<BoardT, PolicyT>::WinProb::numTrials() const {
   return static_cast<uint32_t>(heuristic_.load(std::memory_order_relaxed));
 }
 
-State::State(State *parent, Board board, Board::Player playerToMove)
+template <typename BoardT, typename PolicyT>
+BasicState<BoardT, PolicyT>::BasicState(BasicState *parent, BoardT board,
+                                        Player playerToMove)
     : parent_(parent), board_(board), playerToMove_(playerToMove),
       legalMoves_(board_.legalMoves()) {
-  if (board_.getWinningMove(playerToMove) != Board::kIllegalSpot) {
+  if (board_.getWinningMove(playerToMove) != BoardT::kIllegalSpot) {
     winProb_.markSolved(playerToMove);
+    return;
+  }
+
+  int depth = 0;
+  for (auto *state = parent_; state && depth <= shardedDepth_;
+       state = state->parent_) {
+    depth++;
+  }
+  if (depth <= shardedDepth_) {
+    winProb_.enableSharding();
+  }
+}
+
+template <typename BoardT, typename PolicyT>
+BasicState<BoardT, PolicyT>::~BasicState() {
+  std::vector<BasicState *> stack;
+  auto takeChildren = [&stack](BasicState *state) {
+    for (auto &child : state->children_) {
+      if (auto *p = child.exchange(nullptr, std::memory_order_acquire)) {
+        stack.push_back(p);
+      }
+    }
+  };
+
+  takeChildren(this);
+  while (!stack.empty()) {
+    BasicState *state = stack.back();
+    stack.pop_back();
+    takeChildren(state);
+    delete state;
   }
 }
 
-Board::Spot State::pickMove() const {
+template <typename BoardT, typename PolicyT>
+void *BasicState<BoardT, PolicyT>::operator new(size_t size) {
+  assert(size == sizeof(BasicState));
+  return nodePool().allocate();
+}
+
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::operator delete(void *p) {
+  nodePool().deallocate(p);
+}
+
+template <typename BoardT, typename PolicyT>
+NodePool &BasicState<BoardT, PolicyT>::nodePool() {
+  // Never destroyed: trees held by static objects, or still being freed by
+  // the reclaimer thread, may outlive it otherwise.
+  static NodePool *pool = new NodePool(sizeof(BasicState));
+  return *pool;
+}
+
+template <typename BoardT, typename PolicyT>
+typename BasicState<BoardT, PolicyT>::Spot
+BasicState<BoardT, PolicyT>::pickMove(bool printStats) const {
   auto winningMove = board().getWinningMove(playerToMove());
-  if (winningMove != Board::kIllegalSpot) {
-    printf("Picking wining move\n");
+  if (winningMove != BoardT::kIllegalSpot) {
+    if (printStats) {
+      printf("Picking wining move\n");
+    }
     return winningMove;
   }
 
   auto legalMoves = board_.legalMoves();
 
   double maxProb = 0.0;
-  int bestCol = 0;
-  for (int col = 0; col < Board::kCols; col++) {
-    if (legalMoves.legalRowInCol[col] == Board::LegalMoves::kIllegal) {
+  int bestCol = -1;
+  for (int col = 0; col < BoardT::kCols; col++) {
+    if (legalMoves.legalRowInCol[col] == BoardT::LegalMoves::kIllegal) {
       continue;
     }
 
-    auto *child = children_[col].get();
+    auto *child = getChild(col);
+    if (!child) {
+      continue;
+    }
 
     auto prob = child->winProb().prob(playerToMove_);
-    printf("col[%d] prob: %lf\t", col, prob);
-    if (child && prob > maxProb) {
+    if (printStats) {
+      printf("col[%d] prob: %lf\t", col, prob);
+    }
+    if (prob > maxProb) {
       maxProb = prob;
       bestCol = col;
     }
   }
-  printf("\n");
-  printf("Selected move with win prob: %lf\n", maxProb);
+  if (printStats) {
+    printf("\n");
+  }
 
-  return Board::Spot{.row = legalMoves.legalRowInCol[bestCol], .col = bestCol};
+  if (bestCol == -1) {
+    // No expanded move has a chance. Play the most promising one the search
+    // hasn't tried, or any legal move if it has tried them all.
+    int bestPriority = std::numeric_limits<int>::min();
+    for (int col = 0; col < BoardT::kCols; col++) {
+      if (legalMoves.legalRowInCol[col] == BoardT::LegalMoves::kIllegal) {
+        continue;
+      }
+      int priority = getChild(col) ? std::numeric_limits<int>::min()
+                                   : expansionPriority(col);
+      if (bestCol == -1 || priority > bestPriority) {
+        bestCol = col;
+        bestPriority = priority;
+      }
+    }
+    if (bestCol == -1) {
+      return BoardT::kIllegalSpot;
+    }
+  }
+  if (printStats) {
+    printf("Selected move with win prob: %lf\n", maxProb);
+  }
+
+  return Spot{.row = legalMoves.legalRowInCol[bestCol], .col = bestCol};
 }
 
-std::unique_ptr<State> State::makeMoveAndUpdateState(Board::Spot spot) {
+template <typename BoardT, typename PolicyT>
+std::unique_ptr<BasicState<BoardT, PolicyT>>
+BasicState<BoardT, PolicyT>::makeMoveAndUpdateState(Spot spot) {
   printf("> makeMoveAndUpdateState({.row = %d, .col = %d})\n", spot.row,
          spot.col);
-  auto state = std::move(children_[spot.col]);
+  std::unique_ptr<BasicState> state(
+      children_[spot.col].exchange(nullptr, std::memory_order_acquire));
   if (!state) {
     board_.move(spot, playerToMove_);
-    state = std::make_unique<State>(/*parent=*/nullptr, board_,
-                                    Board::other(playerToMove_));
+    state = std::make_unique<BasicState>(/*parent=*/nullptr, board_,
+                                         BoardT::other(playerToMove_));
   }
 
   state->parent_ = nullptr;
@@ -235,16 +392,24 @@ std::unique_ptr<State> State::makeMoveAndUpdateState(Board::Spot spot) {
   return state;
 }
 
-void State::recordMonteCarloResult(Board::Player trialWinner) {
-  if (trialWinner != Board::Player::One && trialWinner != Board::Player::Two) {
-    trialWinner = Board::other(playerToMove_);
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::recordMonteCarloResult(Player trialWinner) {
+  if (trialWinner != Player::One && trialWinner != Player::Two) {
+    trialWinner = BoardT::other(playerToMove_);
   }
   winProb_.recordTrial(trialWinner);
 }
 
-void State::updateProbabilities() {
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::updateProbabilities() {
   auto *state = this;
   while (state) {
+    // A solved value is final. It may come from a proof (see proveHard) that
+    // knows more than the children's estimates, and markSolvedState already
+    // updated the ancestors.
+    if (state->winProb().solvedWinner() != Player::None) {
+      break;
+    }
     if (!state->hasChildren()) {
       state = state->parent_;
       continue;
@@ -253,9 +418,12 @@ void State::updateProbabilities() {
     auto player = state->playerToMove();
     int maxIdx = -1;
     double maxProb = -1.0;
-    for (int i = 0; i < state->children_.size(); i++) {
-      const auto& child = state->children_[i];
-      if (!child) {
+    // Whether every move is expanded and bootstrapped, i.e. counted below.
+    bool allMoves = state->fullyExpanded();
+    for (int i = 0; i < BoardT::kCols; i++) {
+      auto *child = state->getChild(i);
+      if (!child || !child->isBootstrapped()) {
+        allMoves &= !child;
         continue;
       }
       auto p = child->winProb().prob(player);
@@ -264,140 +432,420 @@ void State::updateProbabilities() {
         maxProb = p;
       }
     }
-    state->winProb_ = state->children_[maxIdx]->winProb();
+    // Until a child has enough trials, keep the estimate from this state's
+    // own trials.
+    if (maxIdx == -1) {
+      break;
+    }
+
+    uint64_t heuristic = state->getChild(maxIdx)->winProb_.heuristic_.load(
+        std::memory_order_relaxed);
+    // The best move so far being a proven loss only makes this state lost if
+    // there are no other moves (see markSolvedState). A solved value holds no
+    // trials to copy without its tag, so keep this state's own estimate.
+    if (!allMoves && state->winProb_.solvedWinnerImpl(heuristic) ==
+                         BoardT::other(player)) {
+      break;
+    }
+
+    // Ancestors only depend on this state's value, so stop as soon as it
+    // doesn't change. That keeps most iterations from writing to the nodes
+    // near the root that every thread reads.
+    if (state->winProb_.heuristic_.load(std::memory_order_relaxed) ==
+        heuristic) {
+      break;
+    }
+    state->winProb_.heuristic_.store(heuristic, std::memory_order_relaxed);
     state = state->parent_;
   }
 }
 
-void State::markSolvedState(Board::Player winningPlayer) {
+template <typename BoardT, typename PolicyT>
+bool BasicState<BoardT, PolicyT>::isBootstrapped() const {
+  return winProb_.solvedWinner() != Player::None ||
+         winProb_.numTrials() >= kMonteCarloBootstrap;
+}
+
+template <typename BoardT, typename PolicyT>
+BasicState<BoardT, PolicyT> *
+BasicState<BoardT, PolicyT>::selectLeaf(std::mt19937 *gen,
+                                        int playoutsPerLeaf) {
+  using Selection = typename PolicyT::Selection;
+  static_assert(SelectionPolicy<Selection, BasicState>);
+
+  BasicState *state = this;
+  while (state->board().winner() == Player::None) {
+    auto wp = state->winProb().prob(state->playerToMove());
+    if (wp == 0.0 || wp == 1.0) {
+      return nullptr;
+    }
+
+    if (!state->hasChildren()) {
+      uint32_t numTrials = state->winProb().numTrials();
+      if (numTrials == WinProb::kCertain) {
+        return nullptr;
+      } else if (numTrials >= kMonteCarloSplitState) {
+        state->widen();
+        return nullptr;
+      }
+      return state;
+    }
+
+    if (state->shouldWiden()) {
+      state->widen();
+    }
+
+    // Spread the bootstrap playouts of new children over ordinary
+    // iterations instead of running them all inside createChildren.
+    if (auto *child = state->childToBootstrap()) {
+      state = child;
+      continue;
+    }
+
+    int col = Selection::pickChild(*state, gen, playoutsPerLeaf);
+    if (col < 0) {
+      return nullptr;
+    }
+    state = state->getChild(col);
+  }
+
+  // A finished game. Nothing marks a draw solved, so unless it's simulated
+  // here, a tree where every line is drawn would never make progress.
+  return state;
+}
+
+template <typename BoardT, typename PolicyT>
+BasicState<BoardT, PolicyT> *
+BasicState<BoardT, PolicyT>::childToBootstrap() const {
+  BasicState *selected = nullptr;
+  uint32_t minTrials = std::numeric_limits<uint32_t>::max();
+  for (int col = 0; col < BoardT::kCols; col++) {
+    auto *child = getChild(col);
+    if (!child || child->isBootstrapped()) {
+      continue;
+    }
+    uint32_t numTrials = child->winProb().numTrials() + child->virtualLoss();
+    if (numTrials < minTrials) {
+      selected = child;
+      minTrials = numTrials;
+    }
+  }
+  return selected;
+}
+
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::markSolvedState(Player winningPlayer) {
   winProb_.markSolved(winningPlayer);
 
   auto *state = parent_;
   while (state) {
-    Board::Player w(Board::other(state->playerToMove()));
-    for (const auto &child : state->children_) {
+    // One winning move solves the state, even if some of its other moves
+    // haven't been expanded yet. Otherwise every move must be solved.
+    Player w(BoardT::other(state->playerToMove()));
+    bool solved = state->fullyExpanded();
+    for (int col = 0; col < BoardT::kCols; col++) {
+      auto *child = state->getChild(col);
       if (!child) {
         continue;
       }
       auto p = child->winProb().solvedWinner();
-      if (p == Board::Player::None) {
-        return;
-      }
       if (p == state->playerToMove()) {
         w = state->playerToMove();
+        solved = true;
+        break;
+      }
+      if (p == Player::None) {
+        solved = false;
       }
     }
+    if (!solved) {
+      return;
+    }
     state->winProb_.markSolved(w);
     state = state->parent_;
   }
 }
 
-Board::Player State::WinProb::solvedWinnerImpl(uint64_t heuristic) const {
+template <typename BoardT, typename PolicyT>
+typename BasicState<BoardT, PolicyT>::Player
+BasicState<BoardT, PolicyT>::WinProb::solvedWinnerImpl(
+    uint64_t heuristic) const {
   int winnerTag = heuristic >> 62;
   if (winnerTag == 0) {
-    return Board::Player::None;
+    return Player::None;
   } else if (winnerTag == 2) {
-    return Board::Player::One;
+    return Player::One;
   } else {
-    return Board::Player::Two;
+    return Player::Two;
   }
 }
 
-Board::Player State::WinProb::solvedWinner() const {
+template <typename BoardT, typename PolicyT>
+/*static*/
+bool BasicState<BoardT, PolicyT>::WinProb::isValid(uint64_t heuristic) {
+  int winnerTag = heuristic >> 62;
+  if (winnerTag != 0) {
+    return winnerTag != 1 && (heuristic << 2) == 0;
+  }
+  auto numTrials = static_cast<uint32_t>(heuristic);
+  return numTrials > 0 && (heuristic >> 32) <= numTrials;
+}
+
+template <typename BoardT, typename PolicyT>
+typename BasicState<BoardT, PolicyT>::Player
+BasicState<BoardT, PolicyT>::WinProb::solvedWinner() const {
   uint64_t heuristic = heuristic_.load(std::memory_order_relaxed);
   return solvedWinnerImpl(heuristic);
 }
 
-void State::createChildren() {
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::addChild(int col) {
+  int row = legalMoves_.legalRowInCol[col];
+  BoardT b(board());
+  b.move(Spot{.row = row, .col = col}, playerToMove_);
+
+  auto s = std::make_unique<BasicState>(
+      /*parent=*/this, /*board=*/b,
+      /*playerToMove=*/BoardT::other(playerToMove_));
+  // Other children are bootstrapped lazily by thinkHard, but a finished
+  // game is never descended into, so record its (free) trials here.
+  if (b.winner() != Player::None) {
+    for (int i = 0; i < kMonteCarloBootstrap; i++) {
+      auto trialWinner = s->monteCarloTrial();
+      s->recordMonteCarloResult(trialWinner);
+    }
+  }
+  children_[col].store(s.release(), std::memory_order_release);
+}
+
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::createChildren() {
   std::unique_lock<std::mutex> lock(childrenMutex_, std::try_to_lock);
 
   if (!lock.owns_lock()) {
     return;
   }
 
-  if (hasChildren_) {
+  if (fullyExpanded()) {
     return;
   }
 
-  auto otherPlayer = Board::other(playerToMove_);
-
-  for (int col = 0; col < Board::kCols; col++) {
-    int row = legalMoves_.legalRowInCol[col];
-    if (row == Board::LegalMoves::kIllegal) {
+  winProb_.flushShards();
+  for (int col = 0; col < BoardT::kCols; col++) {
+    if (legalMoves_.legalRowInCol[col] == BoardT::LegalMoves::kIllegal ||
+        getChild(col)) {
       continue;
     }
+    addChild(col);
+  }
 
-    Board b(board());
-    b.move(Board::Spot{.row = row, .col = col}, playerToMove_);
+  hasChildren_.store(true, std::memory_order_release);
+  assert(winProb().solvedWinner() == Player::None);
 
-    auto s = std::make_unique<State>(/*parent=*/this, /*board=*/b,
-                                     /*playerToMove=*/otherPlayer);
-    for (int i = 0; i < kMonteCarloBootstrap; i++) {
-      auto trialWinner = s->monteCarloTrial();
-      s->recordMonteCarloResult(trialWinner);
+  updateProbabilities();
+}
+
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::widen() {
+  if (!progressiveWidening_) {
+    createChildren();
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(childrenMutex_, std::try_to_lock);
+
+  if (!lock.owns_lock()) {
+    return;
+  }
+
+  int bestCol = -1;
+  int bestPriority = std::numeric_limits<int>::min();
+  for (int col = 0; col < BoardT::kCols; col++) {
+    if (legalMoves_.legalRowInCol[col] == BoardT::LegalMoves::kIllegal ||
+        getChild(col)) {
+      continue;
     }
-    children_[col] = std::move(s);
+    int priority = expansionPriority(col);
+    if (priority > bestPriority) {
+      bestCol = col;
+      bestPriority = priority;
+    }
+  }
+  if (bestCol == -1) {
+    return;
   }
 
-  hasChildren_ = true;
-  assert(winProb().solvedWinner() == Board::Player::None);
+  if (!hasChildren()) {
+    winProb_.flushShards();
+  }
+  addChild(bestCol);
+  hasChildren_.store(true, std::memory_order_release);
+  assert(winProb().solvedWinner() == Player::None);
 
   updateProbabilities();
 }
 
-Board::Player State::monteCarloTrial() const {
-  thread_local std::random_device rd;
-  thread_local std::mt19937 gen(rd());
-
-  Board b(board_);
-  Board::Player player(playerToMove_);
-  Board::Player otherPlayer = Board::other(player);
+template <typename BoardT, typename PolicyT>
+bool BasicState<BoardT, PolicyT>::shouldWiden() const {
+  if (fullyExpanded()) {
+    return false;
+  }
 
-  std::vector<Board::Spot> potentialMoves;
-  potentialMoves.reserve(Board::kCols);
+  uint64_t numChildren = 0;
+  uint64_t numSolved = 0;
+  uint64_t numLost = 0;
+  uint64_t childTrials = 0;
+  for (int col = 0; col < BoardT::kCols; col++) {
+    auto *child = getChild(col);
+    if (!child) {
+      continue;
+    }
+    numChildren++;
+    auto winner = child->winProb().solvedWinner();
+    if (winner == Player::None) {
+      childTrials += child->winProb().numTrials();
+    } else {
+      numSolved++;
+      numLost += winner != playerToMove_;
+    }
+  }
+  if (numChildren == 0) {
+    return false;
+  }
+  // Every move tried so far is a proven loss, so the only hope is in the
+  // others.
+  if (numLost == numChildren) {
+    return true;
+  }
+  // A solved child needs no more trials (and markSolved drops its counts),
+  // so it counts as having its share of them.
+  childTrials += numSolved * kWideningTrials * numChildren;
+  return childTrials >= kWideningTrials * numChildren * numChildren;
+}
 
-  int iters = 0;
-  while (b.winner() == Board::Player::None) {
-    auto winningMove = b.getWinningMove(player);
-    if (winningMove != Board::kIllegalSpot) {
-      return player;
+template <typename BoardT, typename PolicyT>
+bool BasicState<BoardT, PolicyT>::fullyExpanded() const {
+  for (int col = 0; col < BoardT::kCols; col++) {
+    if (legalMoves_.legalRowInCol[col] != BoardT::LegalMoves::kIllegal &&
+        !getChild(col)) {
+      return false;
     }
+  }
+  return true;
+}
 
-    potentialMoves.clear();
-    auto legal = b.legalMoves();
+template <typename BoardT, typename PolicyT>
+int BasicState<BoardT, PolicyT>::expansionPriority(int col) const {
+  using Bits = typename BoardT::Bits;
 
-    for (int col = 0; col < Board::kCols; col++) {
-      int row = legal.legalRowInCol[col];
-      if (row == Board::LegalMoves::kIllegal) {
-        continue;
-      }
+  Bits mine = board_.board_[BoardT::bIdx(playerToMove_)];
+  Bits theirs = board_.board_[BoardT::bIdx(BoardT::other(playerToMove_))];
+  Bits cell = Bits{1} << (col * BoardT::kColStride +
+                          legalMoves_.legalRowInCol[col]);
+  Bits empty = BoardT::kBoardMask & ~(mine | theirs | cell);
+  Bits theirWins = BoardT::winningCells(theirs);
 
-      Board lookAhead(b);
-      Board::Spot spot{.row = row, .col = col};
-      lookAhead.move(spot, player);
-      winningMove = lookAhead.getWinningMove(otherPlayer);
-      if (winningMove == Board::kIllegalSpot) {
-        potentialMoves.push_back(spot);
+  int priority = 0;
+  if (cell & theirWins) {
+    priority += 1000;
+  }
+  if ((cell << 1) & theirWins & BoardT::kBoardMask) {
+    priority -= 500;
+  }
+  priority +=
+      10 * BoardT::popcount(BoardT::winningCells(mine | cell) & empty);
+  priority -= std::abs(2 * col - (BoardT::kCols - 1));
+  return priority;
+}
+
+template <typename BoardT, typename PolicyT>
+size_t BasicState<BoardT, PolicyT>::numNodes() const {
+  size_t count = 0;
+  std::vector<const BasicState *> stack{this};
+  while (!stack.empty()) {
+    const BasicState *state = stack.back();
+    stack.pop_back();
+    count++;
+    for (int col = 0; col < BoardT::kCols; col++) {
+      auto *child = state->getChild(col);
+      if (child) {
+        stack.push_back(child);
       }
     }
+  }
+  return count;
+}
+
+template <typename BoardT, typename PolicyT>
+typename BasicState<BoardT, PolicyT>::Player
+BasicState<BoardT, PolicyT>::monteCarloTrial() const {
+  using Bits = typename BoardT::Bits;
+  using Playout = typename PolicyT::Playout;
+  static_assert(PlayoutPolicy<Playout, BoardT>);
+
+  thread_local std::random_device rd;
+  thread_local uint64_t rng = (uint64_t{rd()} << 32 | rd()) | 1;
+
+  auto winner = board_.winner();
+  if (winner != Player::None) {
+    return winner;
+  }
 
-    if (potentialMoves.empty()) {
-      return otherPlayer;
+  // The same game as one lane of batchMonteCarloTrials.
+  Player player(playerToMove_);
+  Bits cur = board_.board_[BoardT::bIdx(player)];
+  Bits opp = board_.board_[BoardT::bIdx(BoardT::other(player))];
+  while (true) {
+    Bits mask = cur | opp;
+    Bits possible = (mask + BoardT::kBottomMask) & BoardT::kBoardMask;
+    if (possible == 0) {
+      return Player::Draw;
+    }
+    Bits myWin = BoardT::winningCells(cur) & possible;
+    Bits oppWin = BoardT::winningCells(opp) & BoardT::kBoardMask & ~mask;
+    Bits move = Playout::template pickMove<BoardT>(cur, opp, possible, myWin,
+                                                   oppWin, &rng);
+    if (move == 0) {
+      return BoardT::other(player);
+    } else if (move & myWin) {
+      return player;
     }
+    Bits next = cur | move;
+    cur = opp;
+    opp = next;
+    player = BoardT::other(player);
+  }
+}
 
-    std::uniform_int_distribution<> selectionDist(0, potentialMoves.size() - 1);
-    iters++;
-    int selection = selectionDist(gen);
-    b.move(potentialMoves[selection], player);
-    std::swap(player, otherPlayer);
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::addVirtualLoss() {
+  for (auto *state = this; state; state = state->parent_) {
+    state->virtualLoss_.fetch_add(1, std::memory_order_relaxed);
   }
+}
 
-  return b.winner();
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::removeVirtualLoss() {
+  for (auto *state = this; state; state = state->parent_) {
+    state->virtualLoss_.fetch_sub(1, std::memory_order_relaxed);
+  }
 }
 
-int State::height() const {
+template <typename BoardT, typename PolicyT>
+int BasicState<BoardT, PolicyT>::recordMonteCarloBatch() {
+  std::array<Player, kPlayoutLanes> winners;
+  batchMonteCarloTrials<BoardT, typename PolicyT::Playout>(
+      board_, playerToMove_, winners.size(), winners.data());
+  for (auto winner : winners) {
+    recordMonteCarloResult(winner);
+  }
+  return winners.size();
+}
+
+template <typename BoardT, typename PolicyT>
+int BasicState<BoardT, PolicyT>::height() const {
   int h = 1;
-  const State* state = this;
+  const BasicState *state = this;
   while (state) {
     state = state->parent_;
     h++;
@@ -405,102 +853,293 @@ int State::height() const {
   return h;
 }
 
+namespace {
+
+template <typename T> void writeRaw(std::ostream &out, const T &value) {
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T> bool readRaw(std::istream &in, T *value) {
+  in.read(reinterpret_cast<char *>(value), sizeof(*value));
+  return in.good();
+}
+
+} // namespace
+
+template <typename BoardT, typename PolicyT>
+void BasicState<BoardT, PolicyT>::writeSnapshot(std::ostream &out,
+                                                size_t maxNodes) const {
+  // Choose which nodes keep their children by repeatedly expanding the most
+  // visited node whose children still fit in the budget.
+  std::unordered_set<const BasicState *> expanded;
+  uint64_t numNodes = 1;
+  auto byTrials = [](const BasicState *lhs, const BasicState *rhs) {
+    return lhs->winProb().numTrials() < rhs->winProb().numTrials();
+  };
+  std::priority_queue<const BasicState *, std::vector<const BasicState *>,
+                      decltype(byTrials)>
+      frontier(byTrials);
+  frontier.push(this);
+  while (!frontier.empty()) {
+    const BasicState *state = frontier.top();
+    frontier.pop();
+    if (!state->hasChildren()) {
+      continue;
+    }
+
+    int numChildren = 0;
+    for (int col = 0; col < BoardT::kCols; col++) {
+      numChildren += (state->getChild(col) != nullptr);
+    }
+    if (maxNodes != 0 && numNodes + numChildren > maxNodes) {
+      continue;
+    }
+
+    expanded.insert(state);
+    numNodes += numChildren;
+    for (int col = 0; col < BoardT::kCols; col++) {
+      auto *child = state->getChild(col);
+      if (child) {
+        frontier.push(child);
+      }
+    }
+  }
+
+  writeRaw(out, kSnapshotMagic);
+  writeRaw(out, kSnapshotVersion);
+  writeRaw(out, static_cast<uint8_t>(BoardT::kRows));
+  writeRaw(out, static_cast<uint8_t>(BoardT::kCols));
+  writeRaw(out, static_cast<uint8_t>(BoardT::kInARow));
+  writeRaw(out, static_cast<uint8_t>(playerToMove_));
+  writeRaw(out, numNodes);
+  writeRaw(out, board_.board_);
+
+  // Each node is its raw WinProb followed by a mask of the columns that have
+  // a child. Child boards are rebuilt from the parent, so only the root board
+  // is stored.
+  std::vector<const BasicState *> stack{this};
+  while (!stack.empty()) {
+    const BasicState *state = stack.back();
+    stack.pop_back();
+
+    uint16_t childMask = 0;
+    if (expanded.contains(state)) {
+      for (int col = 0; col < BoardT::kCols; col++) {
+        if (state->getChild(col)) {
+          childMask |= 1 << col;
+        }
+      }
+    }
+    uint64_t heuristic =
+        state->winProb_.heuristic_.load(std::memory_order_relaxed);
+    // Trials recorded after a node was solved mean nothing, and readers
+    // reject solved values with counts.
+    if (state->winProb_.solvedWinnerImpl(heuristic) != Player::None) {
+      heuristic &= 3ULL << 62;
+    }
+    writeRaw(out, heuristic);
+    writeRaw(out, childMask);
+
+    for (int col = BoardT::kCols - 1; col >= 0; col--) {
+      if (childMask & (1 << col)) {
+        stack.push_back(state->getChild(col));
+      }
+    }
+  }
+}
+
+template <typename BoardT, typename PolicyT>
+std::unique_ptr<BasicState<BoardT, PolicyT>>
+BasicState<BoardT, PolicyT>::readSnapshot(std::istream &in) {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t rows, cols, inARow, playerToMove;
+  uint64_t numNodes;
+  BoardT board;
+  if (!readRaw(in, &magic) || !readRaw(in, &version) || !readRaw(in, &rows) ||
+      !readRaw(in, &cols) || !readRaw(in, &inARow) ||
+      !readRaw(in, &playerToMove) || !readRaw(in, &numNodes) ||
+      !readRaw(in, &board.board_)) {
+    return nullptr;
+  }
+
+  if (magic != kSnapshotMagic || version != kSnapshotVersion ||
+      rows != BoardT::kRows || cols != BoardT::kCols ||
+      inARow != BoardT::kInARow || playerToMove > 1 || !board.boardIsLegal()) {
+    return nullptr;
+  }
+
+  auto root = readSnapshotNode(in, /*parent=*/nullptr, board,
+                               static_cast<Player>(playerToMove), &numNodes);
+  if (numNodes != 0) {
+    return nullptr;
+  }
+  return root;
+}
+
+template <typename BoardT, typename PolicyT>
+/*static*/
+std::unique_ptr<BasicState<BoardT, PolicyT>>
+BasicState<BoardT, PolicyT>::readSnapshotNode(std::istream &in,
+                                              BasicState *parent, BoardT board,
+                                              Player playerToMove,
+                                              uint64_t *nodesLeft) {
+  // Recursion depth is bounded by the number of cells on the board.
+  uint64_t heuristic;
+  uint16_t childMask;
+  if (*nodesLeft == 0 || !readRaw(in, &heuristic) ||
+      !readRaw(in, &childMask) || !WinProb::isValid(heuristic)) {
+    return nullptr;
+  }
+  (*nodesLeft)--;
+
+  auto state = std::make_unique<BasicState>(parent, board, playerToMove);
+  state->winProb_.heuristic_.store(heuristic, std::memory_order_relaxed);
+  if (childMask == 0) {
+    return state;
+  }
+
+  for (int col = 0; col < BoardT::kCols; col++) {
+    int row = state->legalMoves_.legalRowInCol[col];
+    bool hasChild = childMask & (1 << col);
+    if (hasChild && row == BoardT::LegalMoves::kIllegal) {
+      return nullptr;
+    }
+    if (!hasChild) {
+      continue;
+    }
+
+    BoardT b(board);
+    b.move(Spot{.row = row, .col = col}, playerToMove);
+    auto child = readSnapshotNode(in, state.get(), b,
+                                  BoardT::other(playerToMove), nodesLeft);
+    if (!child) {
+      return nullptr;
+    }
+    state->children_[col].store(child.release(), std::memory_order_release);
+  }
+  state->hasChildren_.store(true, std::memory_order_release);
+
+  return state;
+}
+
+template <typename BoardT, typename PolicyT>
 /*static*/
-void AI::thinkHard(State *root, Clock::duration durationPerMove) {
+uint64_t BasicAI<BoardT, PolicyT>::thinkHard(State *root,
+                                             Clock::duration durationPerMove,
+                                             uint64_t maxPlayouts) {
   std::random_device rd;
   std::mt19937 gen(rd());
 
   auto deadline = Clock::now() + durationPerMove;
 
   int iters = 0;
-  while (Clock::now() < deadline) {
+  int idleIters = 0;
+  uint64_t playouts = 0;
+  while (Clock::now() < deadline &&
+         (maxPlayouts == 0 || playouts < maxPlayouts)) {
     iters++;
-    State *state = root;
-
-    auto wp = state->winProb().prob(state->playerToMove());
+    auto wp = root->winProb().prob(root->playerToMove());
     if (wp == 0.0 || wp == 1.0) {
       break;
     }
 
-    Board b(state->board());
-    while (b.winner() == Board::Player::None) {
-      Board::Player playerToMove = state->playerToMove();
-
-      wp = state->winProb().prob(playerToMove);
-      if (wp == 0.0 || wp == 1.0) {
+    // Descents that widen a node, or lose a race with another thread
+    // expanding one, come back empty now and then. Only a tree with nothing
+    // left to simulate does so for long.
+    State *leaf = root->selectLeaf(&gen, /*playoutsPerLeaf=*/0);
+    if (!leaf) {
+      if (++idleIters >= kMaxIdleIterations) {
         break;
       }
+      continue;
+    }
+    idleIters = 0;
+    // Bootstrap playouts are run in batches, which is much cheaper per
+    // playout than one game at a time.
+    if (!leaf->isBootstrapped()) {
+      playouts += leaf->recordMonteCarloBatch();
+    } else {
+      auto trialWinner = leaf->monteCarloTrial();
+      leaf->recordMonteCarloResult(trialWinner);
+      playouts++;
+    }
+    leaf->updateProbabilities();
+  }
 
-      if (!state->hasChildren()) {
-        uint32_t numTrials = state->winProb().numTrials();
-        if (numTrials == State::WinProb::kCertain) {
-          break;
-        } else if (numTrials >= State::kMonteCarloSplitState) {
-          state->createChildren();
-          break;
-        } else {
-          auto trialWinner = state->monteCarloTrial();
-          state->recordMonteCarloResult(trialWinner);
-          state->updateProbabilities();
-          break;
-        }
-      }
+  return playouts;
+}
 
-      std::array<double, 7> winningProbs;
-      double totalProb = 0.0;
-      for (int col = 0; col < Board::kCols; col++) {
-        auto *child = state->getChild(col);
-        if (child == nullptr) {
-          winningProbs[col] = 0.0;
-        } else {
-          winningProbs[col] = child->winProb().prob(playerToMove);
-          totalProb += winningProbs[col];
-        }
-      }
+template <typename BoardT, typename PolicyT>
+bool BasicAI<BoardT, PolicyT>::gameIsOver() const {
+  return state_->board().winner() != Player::None;
+}
 
-      if (totalProb == 0.0) {
-        for (int col = 0; col < Board::kCols; col++) {
-          if (state->legalMoves().legalRowInCol[col] ==
-              Board::LegalMoves::kIllegal) {
-            continue;
-          }
-          state = state->getChild(col);
-          b = state->board();
-          break;
-        }
-      } else {
-        std::uniform_real_distribution<> selectionDist(0, totalProb);
-        double selector = selectionDist(gen);
-        double cumulative = 0.0;
-        for (int col = 0; col < Board::kCols; col++) {
-          cumulative += winningProbs[col];
-          if (cumulative >= selector) {
-            state = state->getChild(col);
-            b = state->board();
-            break;
-          }
-        }
+template <typename BoardT, typename PolicyT>
+std::unique_ptr<game::Connect4::Move> BasicAI<BoardT, PolicyT>::waitForMove() {
+  auto start = Clock::now();
+  uint64_t playouts = 0;
+
+  Spot spot;
+  if (movePicker_) {
+    spot = movePicker_(*state_, durationPerMove_);
+  } else {
+    bool takeSnapshot = !snapshotPath_.empty() && !snapshotTaken_;
+    if (takeSnapshot) {
+      loadSnapshot(snapshotPath_);
+    }
+
+    std::thread prover;
+    if (proofSearch_) {
+      prover = std::thread([&]() {
+        proveHard(state_.get(), durationPerMove_, *proofSearch_).print();
+      });
+    }
+
+    if (pipeline_) {
+      auto stats = thinkPipelined(state_.get(), durationPerMove_, *pipeline_);
+      stats.print();
+      playouts = stats.playouts;
+    } else {
+      std::atomic<uint64_t> threadPlayouts{0};
+      std::vector<std::thread> threads;
+      const auto &topology = NumaTopology::get();
+      for (int i = 0; i < std::thread::hardware_concurrency(); i++) {
+        threads.push_back(std::thread([&, i]() {
+          // Spread the threads over the NUMA nodes. The nodes each one
+          // expands then live in its own node's memory.
+          topology.bindThreadToNode(i % topology.numNodes());
+          threadPlayouts += BasicAI::thinkHard(state_.get(), durationPerMove_);
+        }));
       }
+      for (int i = 0; i < threads.size(); i++) {
+        threads[i].join();
+      }
+      playouts = threadPlayouts;
     }
-  }
-}
 
-bool AI::gameIsOver() const {
-  return state_->board().winner() != Board::Player::None;
-}
+    if (prover.joinable()) {
+      prover.join();
+    }
+
+    if (takeSnapshot) {
+      saveSnapshot(snapshotPath_, snapshotMaxNodes_);
+      snapshotTaken_ = true;
+    }
 
-std::unique_ptr<game::Connect4::Move> AI::waitForMove() {
-  std::vector<std::thread> threads;
-  for (int i = 0; i < std::thread::hardware_concurrency(); i++) {
-    threads.push_back(std::thread(
-        [&]() { AI::thinkHard(state_.get(), durationPerMove_); }));
+    spot = state_->pickMove();
   }
-  for (int i = 0; i < threads.size(); i++) {
-    threads[i].join();
+
+  lastMoveStats_.thinkTime = Clock::now() - start;
+  lastMoveStats_.playouts = playouts;
+  for (int col = 0; col < BoardT::kCols; col++) {
+    auto *child = state_->getChild(col);
+    lastMoveStats_.colProbs[col] =
+        child ? child->winProb().prob(state_->playerToMove())
+              : std::numeric_limits<double>::quiet_NaN();
   }
 
-  auto spot = state_->pickMove();
-  state_ = state_->makeMoveAndUpdateState(spot);
+  replaceState(state_->makeMoveAndUpdateState(spot));
 
   auto move = std::make_unique<game::Connect4::Move>();
   move->set_col(spot.col);
@@ -508,10 +1147,113 @@ std::unique_ptr<game::Connect4::Move> AI::waitForMove() {
   return move;
 }
 
-void AI::makeServerMove(const game::Connect4::Move &move) {
-  state_ = state_->makeMoveAndUpdateState(
-      Board::Spot{.row = static_cast<int32_t>(move.row()),
-                  .col = static_cast<int32_t>(move.col())});
+template <typename BoardT, typename PolicyT>
+void BasicAI<BoardT, PolicyT>::makeServerMove(
+    const game::Connect4::Move &move) {
+  replaceState(state_->makeMoveAndUpdateState(
+      Spot{.row = static_cast<int32_t>(move.row()),
+           .col = static_cast<int32_t>(move.col())}));
+}
+
+template <typename BoardT, typename PolicyT>
+BasicAI<BoardT, PolicyT>::Reclaimer::~Reclaimer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
 }
 
+template <typename BoardT, typename PolicyT>
+void BasicAI<BoardT, PolicyT>::Reclaimer::retire(std::unique_ptr<State> tree) {
+  if (!tree) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.push_back(std::move(tree));
+  }
+  cv_.notify_one();
+}
+
+template <typename BoardT, typename PolicyT>
+void BasicAI<BoardT, PolicyT>::Reclaimer::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]() { return stopping_ || !retired_.empty(); });
+    if (retired_.empty()) {
+      return;
+    }
+
+    auto trees = std::move(retired_);
+    retired_.clear();
+    lock.unlock();
+    trees.clear();
+    lock.lock();
+  }
+}
+
+template <typename BoardT, typename PolicyT>
+bool BasicAI<BoardT, PolicyT>::loadSnapshot(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+
+  auto state = State::readSnapshot(in);
+  if (!state || state->board().board_ != state_->board().board_ ||
+      state->playerToMove() != state_->playerToMove()) {
+    return false;
+  }
+
+  printf("Loaded %u trials from snapshot %s\n", state->winProb().numTrials(),
+         path.c_str());
+  replaceState(std::move(state));
+  return true;
+}
+
+template <typename BoardT, typename PolicyT>
+bool BasicAI<BoardT, PolicyT>::saveSnapshot(const std::string &path,
+                                            size_t maxNodes) const {
+  // Write to a temporary file first so that a crash mid-write doesn't clobber
+  // the previous snapshot.
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    state_->writeSnapshot(out, maxNodes);
+    if (!out) {
+      return false;
+    }
+  }
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+template class BasicBoard<6, 7, 4>;
+template class BasicBoard<7, 8, 4>;
+template class BasicBoard<5, 4, 4>;
+template class BasicBoard<8, 9, 5>;
+
+template class BasicState<BasicBoard<6, 7, 4>>;
+template class BasicState<BasicBoard<7, 8, 4>>;
+template class BasicState<BasicBoard<5, 4, 4>>;
+template class BasicState<BasicBoard<8, 9, 5>>;
+
+template class BasicAI<BasicBoard<6, 7, 4>>;
+template class BasicAI<BasicBoard<7, 8, 4>>;
+template class BasicAI<BasicBoard<5, 4, 4>>;
+template class BasicAI<BasicBoard<8, 9, 5>>;
+
+template class BasicState<Board, UniformPolicy>;
+template class BasicState<Board, ThreatPolicy>;
+template class BasicState<Board, UniformUcbPolicy>;
+template class BasicState<Board, SafeUcbPolicy>;
+template class BasicState<Board, ThreatUcbPolicy>;
+
+template class BasicAI<Board, UniformPolicy>;
+template class BasicAI<Board, ThreatPolicy>;
+template class BasicAI<Board, UniformUcbPolicy>;
+template class BasicAI<Board, SafeUcbPolicy>;
+template class BasicAI<Board, ThreatUcbPolicy>;
+
 } // namespace ais::conn4
@@ -1,21 +1,34 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <functional>
+#include <istream>
 #include <limits>
+#include <memory>
 #include <mutex>
-
+#include <optional>
+#include <ostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ais/nodePool.h"
 #include "proto/game.pb.h"
 
 namespace ais::conn4 {
 
-class Board {
+// Geometry-independent pieces of a board so that every BasicBoard
+// instantiation shares the same Spot and Player types.
+class BoardBase {
 public:
-  static constexpr int kRows = 6;
-  static constexpr int kCols = 7;
-  static constexpr uint64_t kColMask = (1ULL << (kRows + 1)) - 1;
-
   struct Spot {
     int32_t row{0};
     int32_t col{0};
@@ -29,27 +42,76 @@ public:
     Draw = 3,
   };
 
+  // Board Index
+  static inline int bIdx(Player player) { return static_cast<int>(player); }
+
+  static inline Player other(Player player) {
+    return (player == Player::One) ? Player::Two : Player::One;
+  }
+};
+
+inline bool operator==(const BoardBase::Spot &lhs, const BoardBase::Spot &rhs) {
+  return lhs.row == rhs.row and lhs.col == rhs.col;
+}
+
+inline bool operator!=(const BoardBase::Spot &lhs, const BoardBase::Spot &rhs) {
+  return !(lhs == rhs);
+}
+
+// Each column occupies kColStride = Rows + 1 bits with the top bit kept empty
+// as a sentinel, so that shifting by 1, kColStride, kColStride + 1 and
+// kColStride - 1 never wraps a line from one column into the next. Boards that
+// don't fit in 64 bits use a 128-bit representation.
+template <int Rows, int Cols, int InARow> class BasicBoard : public BoardBase {
+public:
+  static constexpr int kRows = Rows;
+  static constexpr int kCols = Cols;
+  static constexpr int kInARow = InARow;
+  static constexpr int kColStride = kRows + 1;
+
+  static_assert(kRows >= 1 && kCols >= 1);
+  static_assert(kInARow >= 2 && kInARow <= std::max(kRows, kCols));
+  static_assert(kColStride <= 64, "a column must fit in a uint64_t");
+  static_assert(kColStride * kCols <= 128, "board must fit in 128 bits");
+
+  using Bits = std::conditional_t<(kColStride * kCols <= 64), uint64_t,
+                                  unsigned __int128>;
+
+  static constexpr uint64_t kColMask = (1ULL << (kRows + 1)) - 1;
+
+  static constexpr Bits kBottomMask = [] {
+    Bits mask = 0;
+    for (int col = 0; col < kCols; col++) {
+      mask |= Bits{1} << (kColStride * col);
+    }
+    return mask;
+  }();
+
+  static constexpr Bits kBoardMask = kBottomMask * ((Bits{1} << kRows) - 1);
+
   struct LegalMoves {
     static constexpr int8_t kIllegal = kRows;
-    std::array<int8_t, 7> legalRowInCol;
+    std::array<int8_t, kCols> legalRowInCol;
   };
 
-  Board() {}
-  Board(std::string str); // For debug use
-  Board(const Board &other) : board_(other.board_) {}
+  BasicBoard() {}
+  BasicBoard(std::string str); // For debug use
+  BasicBoard(const BasicBoard &other) : board_(other.board_) {}
 
   std::string debugString() const;
 
-  Board &operator=(const Board &other) {
+  BasicBoard &operator=(const BasicBoard &other) {
     board_ = other.board_;
     return *this;
   }
 
-  // Board Index
-  static inline int bIdx(Player player) { return static_cast<int>(player); }
-
-  static inline Player other(Player player) {
-    return (player == Player::One) ? Player::Two : Player::One;
+  static inline int popcount(Bits b) {
+    if constexpr (sizeof(Bits) == sizeof(uint64_t)) {
+      return __builtin_popcountll(b);
+    } else {
+      return __builtin_popcountll(static_cast<uint64_t>(b)) +
+             __builtin_popcountll(static_cast<uint64_t>(b >> 64));
+    }
   }
 
   Player getPlayer(Spot spot) const;
@@ -66,21 +128,72 @@ public:
 
   bool boardIsLegal() const;
 
-  std::array<uint64_t, 2> board_{};
+  std::array<Bits, 2> board_{};
+
+  // Empty or not, the cells that would complete a line of kInARow for the
+  // stones in `b`.
+  [[gnu::always_inline]] static inline Bits winningCells(Bits b) {
+    Bits cells = 0;
+    addWinningCells(b, &cells);
+    return cells;
+  }
+
+  // ORs winningCells(b) into *cells. Every term is a fixed shift, so B can also
+  // be a GCC vector of Bits, which computes the cells of every lane of a
+  // batched playout at once (see connect4Playout.cpp).
+  template <typename B>
+  [[gnu::always_inline]] static inline void addWinningCells(const B &b,
+                                                            B *cells) {
+    for (int shift : {1, kColStride, kColStride + 1, kColStride - 1}) {
+      // The cell is the i-th of the line; the other kInARow - 1 are stones.
+      for (int i = 0; i < kInARow; i++) {
+        B line = ~B{};
+        for (int j = 0; j < kInARow; j++) {
+          int offset = (j - i) * shift;
+          if (offset > 0) {
+            line &= b >> offset;
+          } else if (offset < 0) {
+            line &= b << -offset;
+          }
+        }
+        *cells |= line;
+      }
+    }
+  }
 
 private:
+  // True if kInARow consecutive bits, each `shift` apart, are all set.
+  static inline bool hasLine(Bits b, int shift) {
+    Bits line = b;
+    for (int i = 1; i < kInARow; i++) {
+      line &= b >> (i * shift);
+    }
+    return line != 0;
+  }
 };
 
-inline bool operator==(const Board::Spot &lhs, const Board::Spot &rhs) {
-  return lhs.row == rhs.row and lhs.col == rhs.col;
-}
+using Board = BasicBoard<6, 7, 4>;
 
-inline bool operator!=(const Board::Spot &lhs, const Board::Spot &rhs) {
-  return !(lhs == rhs);
-}
+extern template class BasicBoard<6, 7, 4>;
+extern template class BasicBoard<7, 8, 4>;
+extern template class BasicBoard<5, 4, 4>;
+extern template class BasicBoard<8, 9, 5>;
+
+// Playout and selection policies, defined in connect4Policy.h. The default
+// is the search as it has always been.
+struct SafePlayout;
+struct RouletteSelection;
+template <typename PlayoutT, typename SelectionT> struct SearchPolicy;
+using DefaultPolicy = SearchPolicy<SafePlayout, RouletteSelection>;
 
-class State {
+template <typename BoardT, typename PolicyT = DefaultPolicy> class BasicState {
 public:
+  using Player = typename BoardT::Player;
+  using Spot = typename BoardT::Spot;
+  using LegalMoves = typename BoardT::LegalMoves;
+  using BoardType = BoardT;
+  using Policy = PolicyT;
+
   static constexpr uint64_t kMonteCarloBootstrap = 100;
   static constexpr uint64_t kMonteCarloSplitState = 1000;
 
@@ -94,85 +207,388 @@ public:
       return *this;
     }
 
-    double prob(Board::Player playerToMove) const;
-    void recordTrial(Board::Player winner);
-    void markSolved(Board::Player winner);
-    Board::Player solvedWinnerImpl(uint64_t heuristic) const;
-    Board::Player solvedWinner() const;
+    double prob(Player playerToMove) const;
+    void recordTrial(Player winner);
+    void markSolved(Player winner);
+    Player solvedWinnerImpl(uint64_t heuristic) const;
+    Player solvedWinner() const;
     uint32_t numTrials() const;
 
+    // Nodes near the root are hit by every thread while they're leaves.
+    // Sharded nodes record trials into a per-thread cache line and fold them
+    // into heuristic_ in batches of kShardFlushTrials. Readers only see
+    // heuristic_, so its counts can lag by kShardFlushTrials - 1 trials per
+    // thread. That's safe: the pending trials are a sample like the counted
+    // ones, so the win probability isn't skewed, and the thresholds compared
+    // with numTrials() (bootstrapping, splitting a leaf) are only passed a few
+    // trials late. Once a node is expanded or solved, flushShards has
+    // counted every trial.
+    void enableSharding();
+
   private:
+    friend class BasicState;
+
+    static constexpr int kNumShards = 64;
+    static constexpr uint32_t kShardFlushTrials = 16;
+
+    struct alignas(64) Shard {
+      std::atomic<uint64_t> heuristic{0};
+    };
+
+    struct Shards {
+      std::array<Shard, kNumShards> shards;
+      // Set by flushShards. Trials recorded afterward skip the shards.
+      alignas(64) std::atomic<bool> closed{false};
+    };
+
+    static int shardIdx();
+
+    // Whether a WinProb could hold `heuristic`: some trials and no more wins
+    // than trials, or a solved tag without counts. Snapshots are checked with
+    // it.
+    static bool isValid(uint64_t heuristic);
+
+    // Folds the trials pending in the shards into heuristic_ and closes them.
+    // A node stops getting trials once it's expanded, so anything left in a
+    // shard then would never be counted.
+    void flushShards();
+
     // Storing two uint32_t values together allows the value to be incremented
     // atomically without a mutex. The format is (#playerTwoWins << 32) |
     // #trials
     std::atomic<uint64_t> heuristic_{(1ULL << 32) | 2};
+    std::unique_ptr<Shards> shards_;
   };
 
-  State() = delete;
-  State(State *parent, Board board, Board::Player playerToMove);
+  // Nodes at most this many moves below the root they were created under get
+  // sharded trial counters.
+  static constexpr int kShardedDepth = 2;
 
-  Board::Spot pickMove() const;
-  std::unique_ptr<State> makeMoveAndUpdateState(Board::Spot spot);
+  // For benchmarks: -1 disables sharding for nodes created afterward.
+  static void setShardedDepth(int depth) { shardedDepth_ = depth; }
 
-  const Board &board() const { return board_; }
+  BasicState() = delete;
+  BasicState(BasicState *parent, BoardT board, Player playerToMove);
 
-  Board::Player playerToMove() const { return playerToMove_; }
+  // Frees the subtree iteratively rather than through recursive destructors.
+  ~BasicState();
 
-  bool hasChildren() const { return hasChildren_; }
+  // States come from a NodePool rather than the general heap, so the tree
+  // sits on huge pages and each thread's new nodes in its own NUMA node's
+  // memory.
+  static void *operator new(size_t size);
+  static void operator delete(void *p);
+  static NodePool &nodePool();
+
+  // Prints each column's win probability unless printStats is false.
+  Spot pickMove(bool printStats = true) const;
+  std::unique_ptr<BasicState> makeMoveAndUpdateState(Spot spot);
+
+  const BoardT &board() const { return board_; }
+
+  Player playerToMove() const { return playerToMove_; }
+
+  bool hasChildren() const {
+    return hasChildren_.load(std::memory_order_acquire);
+  }
 
   const WinProb &winProb() const { return winProb_; }
 
-  const Board::LegalMoves &legalMoves() const { return legalMoves_; }
+  const LegalMoves &legalMoves() const { return legalMoves_; }
 
-  void recordMonteCarloResult(Board::Player trialWinner);
+  void recordMonteCarloResult(Player trialWinner);
 
   void updateProbabilities();
 
-  void markSolvedState(Board::Player winningPlayer);
+  void markSolvedState(Player winningPlayer);
 
+  // Children are created without playouts. Until a child has
+  // kMonteCarloBootstrap trials it is ignored by updateProbabilities and
+  // thinkHard descends into it ahead of its bootstrapped siblings.
   void createChildren();
 
-  State *getChild(int col) const { return children_[col].get(); }
+  // Progressive widening: thinkHard adds children one at a time, best
+  // expansionPriority first, instead of all at once. Another child is added
+  // when shouldWiden() says the existing ones have been searched enough, so
+  // moves the search never comes back to are never allocated or bootstrapped.
+  // With widening disabled, widen() is createChildren().
+  void widen();
+  bool shouldWiden() const;
+  bool fullyExpanded() const;
+
+  // Cheap move ordering from the bitboards, higher first: blocking an
+  // immediate loss, then the number of threats the move leaves, penalizing a
+  // move that lets the opponent win on top of it, then closeness to the
+  // centre.
+  int expansionPriority(int col) const;
+
+  // A node with k children gets another once they have kWideningTrials * k^2
+  // trials between them.
+  static constexpr uint64_t kWideningTrials = kMonteCarloBootstrap;
+
+  // For benchmarks: false makes widen() expand every child at once.
+  static void setProgressiveWidening(bool enabled) {
+    progressiveWidening_ = enabled;
+  }
 
-  Board::Player monteCarloTrial() const;
+  // Nodes in the tree rooted here.
+  size_t numNodes() const;
+
+  bool isBootstrapped() const;
+
+  // Walks from this state down to a leaf to run playouts from, the descent
+  // that thinkHard and thinkPipelined share. Nodes that are due are widened
+  // on the way, children still being bootstrapped come first and otherwise
+  // the selection policy picks, with playoutsPerLeaf passed on to it. A
+  // finished game (in practice a draw, since a win solves its parent) is a
+  // leaf whose playouts are free. Returns nullptr if the walk ended without a
+  // leaf to simulate, e.g. because it expanded a node or reached a solved one.
+  BasicState *selectLeaf(std::mt19937 *gen, int playoutsPerLeaf);
+
+  // The child with the fewest trials (counting virtual losses) that isn't
+  // bootstrapped yet, if any.
+  BasicState *childToBootstrap() const;
+
+  // Playouts that the pipelined search has scheduled at or below this state
+  // but not yet backpropagated. Selection counts them as losses so that
+  // concurrent selections spread out.
+  uint32_t virtualLoss() const {
+    return virtualLoss_.load(std::memory_order_relaxed);
+  }
+
+  // Adjust the virtual loss of this state and all of its ancestors.
+  void addVirtualLoss();
+  void removeVirtualLoss();
+
+  BasicState *getChild(int col) const {
+    return children_[col].load(std::memory_order_acquire);
+  }
+
+  // One playout with the policy's PlayoutT.
+  Player monteCarloTrial() const;
+
+  // Runs one lockstep batch of kPlayoutLanes playouts (see connect4Playout.h)
+  // and records the results. Returns the number of playouts.
+  int recordMonteCarloBatch();
 
   int height() const;
 
+  // Writes the tree rooted at this state in preorder. When maxNodes is nonzero
+  // only the most visited nodes are kept. A node's children are either all
+  // written or all dropped, so a pruned node is simply expanded again after it
+  // is loaded.
+  void writeSnapshot(std::ostream &out, size_t maxNodes = 0) const;
+
+  // Returns nullptr if the stream doesn't hold a snapshot for this geometry.
+  static std::unique_ptr<BasicState> readSnapshot(std::istream &in);
+
 private:
-  State *parent_{nullptr};
-  Board board_;
-  Board::Player playerToMove_;
+  static inline int shardedDepth_ = kShardedDepth;
+  static inline bool progressiveWidening_ = true;
+
+  // Creates the child for `col`. Requires childrenMutex_.
+  void addChild(int col);
+
+  static constexpr uint32_t kSnapshotMagic = 0x4e533443; // "C4SN"
+  static constexpr uint16_t kSnapshotVersion = 1;
+
+  static std::unique_ptr<BasicState>
+  readSnapshotNode(std::istream &in, BasicState *parent, BoardT board,
+                   Player playerToMove, uint64_t *nodesLeft);
+
+  BasicState *parent_{nullptr};
+  BoardT board_;
+  Player playerToMove_;
   WinProb winProb_{};
-  Board::LegalMoves legalMoves_;
-  bool hasChildren_{false};
+  LegalMoves legalMoves_;
+  std::atomic<bool> hasChildren_{false};
+  std::atomic<uint32_t> virtualLoss_{0};
   std::mutex childrenMutex_;
-  std::array<std::unique_ptr<State>, Board::kCols> children_;
+  // Owned. Children are added while other threads walk the tree without
+  // childrenMutex_, so each one is published with a release store once it's
+  // fully built, and read with an acquire load through getChild.
+  std::array<std::atomic<BasicState *>, BoardT::kCols> children_{};
+};
+
+using State = BasicState<Board>;
+
+// Tuning for BasicAI::thinkPipelined. Selection threads walk the tree and push
+// batches of leaves to simulation threads, which run the playouts and hand the
+// leaves back for backpropagation.
+struct PipelineOptions {
+  int selectionThreads{1};
+  int simulationThreads{1};
+  // Leaves per batch.
+  int batchSize{16};
+  // Batches each queue can hold.
+  int queueDepth{64};
+  int playoutsPerLeaf{8};
+};
+
+struct PipelineStats {
+  double seconds{0.0};
+  uint64_t leavesSelected{0};
+  uint64_t playouts{0};
+  uint64_t leavesBackpropagated{0};
+  // Times a selection thread found the simulation queue full, or a simulation
+  // thread found it empty.
+  uint64_t selectionStalls{0};
+  uint64_t simulationStalls{0};
+
+  void print() const;
+};
+
+// Tuning for BasicAI::proveHard, which runs depth-first proof-number search
+// (see connect4Proof.h) on the nodes near the root of the tree.
+struct ProofSearchOptions {
+  // log2 of the number of transposition table entries.
+  int tableBits{18};
+  // Nodes at most this many moves below the root are tried.
+  int targetDepth{2};
+  // Node budget for the first attempt at each target; every round over the
+  // targets doubles it.
+  uint64_t initialNodes{1 << 12};
+};
+
+struct ProofSearchStats {
+  double seconds{0.0};
+  uint64_t nodes{0};
+  uint64_t attempts{0};
+  uint64_t proofs{0};
+
+  void print() const;
 };
 
-class AI {
+template <typename BoardT, typename PolicyT = DefaultPolicy> class BasicAI {
 public:
+  using Player = typename BoardT::Player;
+  using Spot = typename BoardT::Spot;
+  using State = BasicState<BoardT, PolicyT>;
   typedef std::chrono::high_resolution_clock Clock;
 
-  AI(int aiPlayer, int usecPerMove)
-      : aiPlayer_(static_cast<Board::Player>(aiPlayer)),
-        serverPlayer_(static_cast<Board::Player>((aiPlayer + 1) % 2)),
+  BasicAI(int aiPlayer, int usecPerMove)
+      : aiPlayer_(static_cast<Player>(aiPlayer)),
+        serverPlayer_(static_cast<Player>((aiPlayer + 1) % 2)),
         durationPerMove_(std::chrono::microseconds(usecPerMove)),
-        state_(std::make_unique<State>(/*parent=*/nullptr, Board(),
-                                       Board::Player::One)) {}
-
-  static void thinkHard(State *root, AI::Clock::duration durationPerMove);
+        state_(std::make_unique<State>(/*parent=*/nullptr, BoardT(),
+                                       Player::One)) {}
+
+  // Returns the number of playouts run. A nonzero maxPlayouts also stops the
+  // search once this thread has run that many. The search also stops early
+  // if kMaxIdleIterations descents in a row find nothing to simulate.
+  static uint64_t thinkHard(State *root, Clock::duration durationPerMove,
+                            uint64_t maxPlayouts = 0);
+  static constexpr int kMaxIdleIterations = 1 << 16;
+
+  // Searches with separate selection and simulation stages (see
+  // PipelineOptions) instead of thinkHard's one-thread-does-everything loop.
+  static PipelineStats thinkPipelined(State *root,
+                                      Clock::duration durationPerMove,
+                                      const PipelineOptions &options);
+
+  // Proves or disproves wins for the nodes near the root until the time runs
+  // out, marking the proved ones solved so that thinkHard stops spending
+  // playouts on them. Meant to run on its own thread next to thinkHard.
+  static ProofSearchStats proveHard(State *root,
+                                    Clock::duration durationPerMove,
+                                    const ProofSearchOptions &options);
 
   bool gameIsOver() const;
 
+  // The position the AI is in, i.e. the root of the search.
+  const State &state() const { return *state_; }
+
   std::unique_ptr<game::Connect4::Move> waitForMove();
 
+  struct MoveStats {
+    Clock::duration thinkTime{};
+    // Zero when a MovePicker chose the move.
+    uint64_t playouts{0};
+    // The win probability of each column for the player who moved, NaN for
+    // columns without a child in the tree.
+    std::array<double, BoardT::kCols> colProbs{};
+  };
+
+  // Describes the last move returned by waitForMove.
+  const MoveStats &lastMoveStats() const { return lastMoveStats_; }
+
   void makeServerMove(const game::Connect4::Move &move);
 
+  // Replaces the search tree with the one in `path` if it was saved from the
+  // current position. Returns false if nothing was loaded.
+  bool loadSnapshot(const std::string &path);
+
+  bool saveSnapshot(const std::string &path, size_t maxNodes = 0) const;
+
+  // Warm start: the first position this AI thinks about is loaded from `path`
+  // before thinking and saved back to it afterward.
+  void useSnapshot(std::string path, size_t maxNodes) {
+    snapshotPath_ = std::move(path);
+    snapshotMaxNodes_ = maxNodes;
+  }
+
+  void usePipeline(const PipelineOptions &options) { pipeline_ = options; }
+
+  // Runs proveHard on one more thread while thinking.
+  void useProofSearch(const ProofSearchOptions &options) {
+    proofSearch_ = options;
+  }
+
+  // Hands move selection to an outside search, e.g. a SearchCoordinator
+  // spreading the search over worker processes. The picker is given the
+  // current position and the time budget for the move.
+  using MovePicker =
+      std::function<Spot(const State &root, Clock::duration budget)>;
+  void useMovePicker(MovePicker picker) { movePicker_ = std::move(picker); }
+
 private:
-  const Board::Player aiPlayer_;
-  const Board::Player serverPlayer_;
+  // Frees discarded subtrees on a background thread so that a move can be
+  // reported without waiting for millions of nodes to be deleted.
+  class Reclaimer {
+  public:
+    Reclaimer() : thread_([this]() { run(); }) {}
+    ~Reclaimer();
+
+    void retire(std::unique_ptr<State> tree);
+
+  private:
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::unique_ptr<State>> retired_;
+    bool stopping_{false};
+    std::thread thread_;
+  };
+
+  void replaceState(std::unique_ptr<State> state) {
+    reclaimer_.retire(std::exchange(state_, std::move(state)));
+  }
+
+  const Player aiPlayer_;
+  const Player serverPlayer_;
   const Clock::duration durationPerMove_;
+  Reclaimer reclaimer_;
   std::unique_ptr<State> state_;
+  std::string snapshotPath_;
+  size_t snapshotMaxNodes_{0};
+  bool snapshotTaken_{false};
+  std::optional<PipelineOptions> pipeline_;
+  std::optional<ProofSearchOptions> proofSearch_;
+  MovePicker movePicker_;
+  MoveStats lastMoveStats_;
 };
 
+using AI = BasicAI<Board>;
+
+extern template class BasicState<BasicBoard<6, 7, 4>>;
+extern template class BasicState<BasicBoard<7, 8, 4>>;
+extern template class BasicState<BasicBoard<5, 4, 4>>;
+extern template class BasicState<BasicBoard<8, 9, 5>>;
+
+extern template class BasicAI<BasicBoard<6, 7, 4>>;
+extern template class BasicAI<BasicBoard<7, 8, 4>>;
+extern template class BasicAI<BasicBoard<5, 4, 4>>;
+extern template class BasicAI<BasicBoard<8, 9, 5>>;
+
 } // namespace ais::conn4
@@ -0,0 +1,297 @@
+#include "ais/connect4Analysis.h"
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+namespace ais::conn4 {
+
+namespace {
+
+bool isBlank(const std::string &line) {
+  return line.find_first_not_of(" \t\r") == std::string::npos;
+}
+
+// Rows are bottom-aligned: rows.back() is row 0.
+bool parseTextBoard(const std::vector<std::string> &rows, Board *board,
+                    std::string *error) {
+  if (rows.size() > Board::kRows) {
+    *error = "too many rows";
+    return false;
+  }
+
+  Board b;
+  int numRows = rows.size();
+  for (int i = 0; i < numRows; i++) {
+    int row = numRows - 1 - i;
+    std::string line = rows[i];
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    // Editors tend to strip trailing spaces, so short rows are padded.
+    if (line.size() > Board::kCols) {
+      *error = "row is wider than the board";
+      return false;
+    }
+    for (int col = 0; col < static_cast<int>(line.size()); col++) {
+      char ch = line[col];
+      if (ch == 'X') {
+        b.move(Board::Spot{.row = row, .col = col}, Board::Player::One);
+      } else if (ch == 'O') {
+        b.move(Board::Spot{.row = row, .col = col}, Board::Player::Two);
+      } else if (ch != ' ' && ch != '.') {
+        *error = std::string("unexpected character '") + ch + "'";
+        return false;
+      }
+    }
+  }
+
+  *board = b;
+  return true;
+}
+
+bool parseBitboards(const std::string &line, Board *board,
+                    std::string *error) {
+  const char *str = line.c_str();
+  char *end = nullptr;
+  Board b;
+  for (int i = 0; i < 2; i++) {
+    errno = 0;
+    b.board_[i] = strtoull(str, &end, 0);
+    if (end == str || errno != 0) {
+      *error = "expected two bitboards";
+      return false;
+    }
+    str = end;
+  }
+  if (!isBlank(str)) {
+    *error = "trailing characters after the bitboards";
+    return false;
+  }
+  if (b.board_[0] & b.board_[1]) {
+    *error = "bitboards overlap";
+    return false;
+  }
+
+  *board = b;
+  return true;
+}
+
+const char *playerName(Board::Player player) {
+  switch (player) {
+  case Board::Player::One:
+    return "\"X\"";
+  case Board::Player::Two:
+    return "\"O\"";
+  case Board::Player::Draw:
+    return "\"draw\"";
+  default:
+    return "null";
+  }
+}
+
+// The outcome of a solved move from the point of view of the player making
+// it.
+const char *outcomeName(Board::Player solvedWinner,
+                        Board::Player playerToMove) {
+  if (solvedWinner == Board::Player::None) {
+    return "null";
+  } else if (solvedWinner == Board::Player::Draw) {
+    return "\"draw\"";
+  }
+  return solvedWinner == playerToMove ? "\"win\"" : "\"loss\"";
+}
+
+} // namespace
+
+bool readPositions(std::istream &in, std::vector<Position> *positions,
+                   std::string *error) {
+  std::vector<std::string> rows;
+  int lineNum = 0;
+  int blockStart = 0;
+
+  auto fail = [&](int line, const std::string &message) {
+    *error = "line " + std::to_string(line) + ": " + message;
+    return false;
+  };
+
+  auto addPosition = [&](const Board &board, int line) {
+    if (!board.boardIsLegal()) {
+      return fail(line, "illegal position");
+    }
+    positions->push_back(Position{.board = board, .line = line});
+    return true;
+  };
+
+  auto finishBlock = [&]() {
+    if (rows.empty()) {
+      return true;
+    }
+    Board board;
+    std::string message;
+    if (!parseTextBoard(rows, &board, &message)) {
+      return fail(blockStart, message);
+    }
+    rows.clear();
+    return addPosition(board, blockStart);
+  };
+
+  std::string line;
+  while (std::getline(in, line)) {
+    lineNum++;
+    if (isBlank(line) || line[0] == '#') {
+      if (!finishBlock()) {
+        return false;
+      }
+      continue;
+    }
+
+    auto first = line.find_first_not_of(" \t");
+    if (rows.empty() && isdigit(line[first])) {
+      Board board;
+      std::string message;
+      if (!parseBitboards(line, &board, &message)) {
+        return fail(lineNum, message);
+      }
+      if (!addPosition(board, lineNum)) {
+        return false;
+      }
+      continue;
+    }
+
+    if (rows.empty()) {
+      blockStart = lineNum;
+    }
+    rows.push_back(line);
+  }
+
+  return finishBlock();
+}
+
+AnalysisStats analyzePositions(
+    const std::vector<Position> &positions, const AnalysisOptions &options,
+    const std::function<void(size_t index, const SearchResult &result)>
+        &onResult) {
+  auto duration = options.duration.count() > 0 ? options.duration
+                                               : AnalysisOptions::kMaxDuration;
+
+  std::atomic<size_t> nextIndex{0};
+  std::atomic<uint64_t> playouts{0};
+  std::mutex resultMutex;
+
+  auto analyze = [&]() {
+    for (size_t i = nextIndex++; i < positions.size(); i = nextIndex++) {
+      const auto &board = positions[i].board;
+      SearchResult result;
+      if (board.winner() == Board::Player::None) {
+        auto playerToMove = board.nextPlayer();
+        auto winningMove = board.getWinningMove(playerToMove);
+        if (winningMove != Board::kIllegalSpot) {
+          // The root was solved when it was created; there's nothing to
+          // search.
+          result.columns[winningMove.col].solvedWinner = playerToMove;
+          result.columns[winningMove.col].winProb = 1.0;
+        } else {
+          // Expanded up front so that even small playout budgets are spread
+          // over every column.
+          State root(/*parent=*/nullptr, board, playerToMove);
+          root.createChildren();
+          auto playoutsRun =
+              AI::thinkHard(&root, duration, /*maxPlayouts=*/options.playouts);
+          result = collectSearchResult(root);
+          result.playouts = playoutsRun;
+        }
+      }
+      playouts += result.playouts;
+
+      std::lock_guard<std::mutex> lock(resultMutex);
+      onResult(i, result);
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.numThreads; i++) {
+    threads.push_back(std::thread(analyze));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  return AnalysisStats{.positions = positions.size(),
+                       .playouts = playouts,
+                       .seconds = elapsed.count()};
+}
+
+std::string analysisToJson(size_t index, const Position &position,
+                           const SearchResult &result) {
+  const auto &board = position.board;
+  auto playerToMove = board.nextPlayer();
+
+  char buf[256];
+  std::string json;
+  snprintf(buf, sizeof(buf), "{\"index\":%zu,\"line\":%d,\"toMove\":%s", index,
+           position.line, playerName(playerToMove));
+  json += buf;
+
+  auto winner = board.winner();
+  if (winner != Board::Player::None) {
+    json += ",\"winner\":";
+    json += playerName(winner);
+    json += ",\"bestMove\":-1,\"solved\":null,\"playouts\":0,\"columns\":[]}";
+    return json;
+  }
+
+  // The position is solved once a move is proven to win or every move is
+  // proven.
+  auto legalMoves = board.legalMoves();
+  auto solved = Board::Player::None;
+  bool allSolved = true;
+  bool anyDraw = false;
+  for (int col = 0; col < Board::kCols; col++) {
+    if (legalMoves.legalRowInCol[col] == Board::LegalMoves::kIllegal) {
+      continue;
+    }
+    auto columnWinner = result.columns[col].solvedWinner;
+    if (columnWinner == playerToMove) {
+      solved = playerToMove;
+    }
+    allSolved = allSolved && columnWinner != Board::Player::None;
+    anyDraw = anyDraw || columnWinner == Board::Player::Draw;
+  }
+  if (solved == Board::Player::None && allSolved) {
+    solved = anyDraw ? Board::Player::Draw : Board::other(playerToMove);
+  }
+
+  snprintf(buf, sizeof(buf),
+           ",\"bestMove\":%d,\"solved\":%s,\"playouts\":%llu,\"columns\":[",
+           result.bestMove(board, playerToMove).col,
+           outcomeName(solved, playerToMove),
+           static_cast<unsigned long long>(result.playouts));
+  json += buf;
+
+  bool first = true;
+  for (int col = 0; col < Board::kCols; col++) {
+    if (legalMoves.legalRowInCol[col] == Board::LegalMoves::kIllegal) {
+      continue;
+    }
+    const auto &column = result.columns[col];
+    snprintf(buf, sizeof(buf),
+             "%s{\"col\":%d,\"trials\":%llu,\"winProb\":%.4f,\"solved\":%s}",
+             first ? "" : ",", col,
+             static_cast<unsigned long long>(column.trials), column.winProb,
+             outcomeName(column.solvedWinner, playerToMove));
+    json += buf;
+    first = false;
+  }
+  json += "]}";
+  return json;
+}
+
+} // namespace ais::conn4
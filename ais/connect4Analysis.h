@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "ais/connect4AI.h"
+#include "ais/connect4SearchResult.h"
+
+namespace ais::conn4 {
+
+struct Position {
+  Board board;
+  // Line of the input the position started on, for error messages.
+  int line{0};
+};
+
+// Reads positions in either of two forms, mixed freely:
+//
+//   * Two bitboards on one line, "<playerOne> <playerTwo>", in the Board
+//     layout. Any base strtoull accepts, e.g. 0x10 or 16.
+//   * Board(std::string) text: rows of X, O and ' ' or '.', top row first.
+//     Since pieces stack, empty rows are only ever on top, so a board may
+//     leave them out. Boards are separated by blank lines.
+//
+// Lines starting with '#' are comments. Returns false and sets `error` on the
+// first malformed or illegal position.
+bool readPositions(std::istream &in, std::vector<Position> *positions,
+                   std::string *error);
+
+struct AnalysisOptions {
+  // The time limit for a search given only a playout budget, in case the
+  // position runs out of things to simulate before the budget runs out.
+  static constexpr AI::Clock::duration kMaxDuration = std::chrono::minutes(1);
+
+  int numThreads{1};
+  // Per position. The search stops at whichever budget runs out first; a zero
+  // budget is unlimited (or kMaxDuration for the duration), but at least one
+  // of them must be set.
+  uint64_t playouts{0};
+  AI::Clock::duration duration{};
+};
+
+struct AnalysisStats {
+  size_t positions{0};
+  uint64_t playouts{0};
+  double seconds{0.0};
+};
+
+// Searches every position once, in parallel across positions, and calls
+// onResult as each one finishes. Calls to onResult are serialized but arrive in
+// completion order, not input order.
+AnalysisStats analyzePositions(
+    const std::vector<Position> &positions, const AnalysisOptions &options,
+    const std::function<void(size_t index, const SearchResult &result)>
+        &onResult);
+
+// One JSON object, without a trailing newline, describing the result of
+// analyzing positions[index].
+std::string analysisToJson(size_t index, const Position &position,
+                           const SearchResult &result);
+
+} // namespace ais::conn4
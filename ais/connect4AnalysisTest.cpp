@@ -0,0 +1,130 @@
+#include "ais/connect4Analysis.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ais::conn4 {
+
+TEST(Analysis, readPositions) {
+  std::istringstream in("# Text boards may leave out the empty rows on top.\n"
+                        "  O\n"
+                        "  X\n"
+                        "  XOO X\n"
+                        "\n"
+                        "0x0 0x0\n"
+                        "\n"
+                        ".......\n"
+                        "...X...\n");
+  std::vector<Position> positions;
+  std::string error;
+  ASSERT_TRUE(readPositions(in, &positions, &error)) << error;
+  ASSERT_EQ(positions.size(), 3);
+
+  Board expected("       \n"
+                 "       \n"
+                 "       \n"
+                 "  O    \n"
+                 "  X    \n"
+                 "  XOO X\n");
+  EXPECT_EQ(positions[0].board.board_, expected.board_);
+  EXPECT_EQ(positions[0].line, 2);
+
+  EXPECT_EQ(positions[1].board.board_, Board().board_);
+  EXPECT_EQ(positions[1].line, 6);
+
+  EXPECT_EQ(positions[2].board.getPlayer({.row = 0, .col = 3}),
+            Board::Player::One);
+  EXPECT_EQ(positions[2].board.nextPlayer(), Board::Player::Two);
+}
+
+TEST(Analysis, bitboardsMatchTextBoards) {
+  Board board("       \n"
+              "       \n"
+              "       \n"
+              "       \n"
+              "   OO  \n"
+              "   XX  \n");
+  std::ostringstream out;
+  out << std::hex << "0x" << board.board_[0] << " 0x" << board.board_[1]
+      << "\n";
+
+  std::istringstream in(out.str());
+  std::vector<Position> positions;
+  std::string error;
+  ASSERT_TRUE(readPositions(in, &positions, &error)) << error;
+  ASSERT_EQ(positions.size(), 1);
+  EXPECT_EQ(positions[0].board.board_, board.board_);
+}
+
+TEST(Analysis, rejectsBadInput) {
+  for (const char *input : {"X\n O\n", // Floating piece.
+                            "XX\n",       // Too many X.
+                            "  Q\n", "1 1\n", "0x1\n", "X      X\n"}) {
+    std::istringstream in(input);
+    std::vector<Position> positions;
+    std::string error;
+    EXPECT_FALSE(readPositions(in, &positions, &error)) << input;
+    EXPECT_FALSE(error.empty());
+  }
+
+  std::istringstream in("X\n\nX\n O\n");
+  std::vector<Position> positions;
+  std::string error;
+  readPositions(in, &positions, &error);
+  EXPECT_EQ(error.rfind("line 3: ", 0), 0) << error;
+}
+
+TEST(Analysis, analyzePositions) {
+  std::istringstream in("   OO\n"
+                        "   XX\n"
+                        "\n"
+                        "X\n"
+                        "XO\n"
+                        "XOO\n"
+                        "\n"
+                        "OOO\n"
+                        "XXXX\n");
+  std::vector<Position> positions;
+  std::string error;
+  ASSERT_TRUE(readPositions(in, &positions, &error)) << error;
+
+  std::vector<std::string> lines(positions.size());
+  auto stats = analyzePositions(
+      positions, AnalysisOptions{.numThreads = 2, .playouts = 20000},
+      [&](size_t index, const SearchResult &result) {
+        lines[index] = analysisToJson(index, positions[index], result);
+      });
+
+  EXPECT_EQ(stats.positions, 3);
+  EXPECT_GT(stats.playouts, 0);
+
+  auto contains = [](const std::string &line, const std::string &text) {
+    return line.find(text) != std::string::npos;
+  };
+  EXPECT_TRUE(contains(lines[0], "\"bestMove\":2") ||
+              contains(lines[0], "\"bestMove\":5"))
+      << lines[0];
+  EXPECT_TRUE(contains(lines[0], "{\"col\":6,\"trials\":")) << lines[0];
+  EXPECT_TRUE(contains(lines[1], "\"bestMove\":0")) << lines[1];
+  EXPECT_TRUE(contains(lines[2], "\"winner\":\"X\"")) << lines[2];
+}
+
+TEST(Analysis, finishesDrawnPosition) {
+  // Every line from here is a draw, which leaves the search nothing to solve.
+  std::istringstream in("233451389541154 45807181661341\n");
+  std::vector<Position> positions;
+  std::string error;
+  ASSERT_TRUE(readPositions(in, &positions, &error)) << error;
+
+  auto start = AI::Clock::now();
+  auto stats = analyzePositions(positions, AnalysisOptions{.playouts = 1000},
+                                [](size_t, const SearchResult &) {});
+  EXPECT_EQ(stats.positions, 1);
+  EXPECT_GE(stats.playouts, 1000);
+  EXPECT_LT(AI::Clock::now() - start, std::chrono::seconds(10));
+}
+
+} // namespace ais::conn4
@@ -0,0 +1,336 @@
+#include "ais/connect4AI.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ais/connect4Playout.h"
+#include "ais/connect4Policy.h"
+#include "ais/connect4Positions.h"
+#include "ais/connect4Proof.h"
+#include "benchmark/benchmark.h"
+
+namespace ais::conn4 {
+namespace {
+
+void BM_monteCarloTrial(benchmark::State &bmState) {
+  State state(/*parent=*/nullptr, Board(), Board::Player::One);
+  for (auto _ : bmState) {
+    benchmark::DoNotOptimize(state.monteCarloTrial());
+  }
+  bmState.SetItemsProcessed(bmState.iterations());
+}
+
+BENCHMARK(BM_monteCarloTrial);
+
+void BM_batchMonteCarloTrials(benchmark::State &bmState) {
+  std::array<Board::Player, kPlayoutLanes> winners;
+  for (auto _ : bmState) {
+    batchMonteCarloTrials(Board(), Board::Player::One, winners.size(),
+                          winners.data());
+    benchmark::DoNotOptimize(winners);
+  }
+  bmState.SetItemsProcessed(bmState.iterations() * winners.size());
+  bmState.SetLabel(batchPlayoutIsa<Board>());
+}
+
+BENCHMARK(BM_batchMonteCarloTrials);
+
+// Runs thinkHard from the opening position on args[0] threads for 200ms per
+// iteration. args[1] selects whether hot nodes use sharded trial counters.
+void BM_thinkHardScaling(benchmark::State &bmState) {
+  int numThreads = bmState.range(0);
+  State::setShardedDepth(bmState.range(1) ? State::kShardedDepth : -1);
+
+  uint64_t playouts = 0;
+  for (auto _ : bmState) {
+    State root(/*parent=*/nullptr, Board(), Board::Player::One);
+    std::vector<std::thread> threads;
+    std::vector<uint64_t> threadPlayouts(numThreads);
+    for (int i = 0; i < numThreads; i++) {
+      threads.push_back(std::thread([&, i]() {
+        const auto &topology = NumaTopology::get();
+        topology.bindThreadToNode(i % topology.numNodes());
+        threadPlayouts[i] =
+            AI::thinkHard(&root, std::chrono::milliseconds(200));
+      }));
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (auto n : threadPlayouts) {
+      playouts += n;
+    }
+  }
+
+  bmState.counters["playouts/s"] =
+      benchmark::Counter(playouts, benchmark::Counter::kIsRate);
+  State::setShardedDepth(State::kShardedDepth);
+}
+
+BENCHMARK(BM_thinkHardScaling)
+    ->ArgsProduct({{1, 2, 4, 8, 16, 32, 64}, {0, 1}})
+    ->ArgNames({"threads", "sharded"})
+    ->Iterations(5)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Runs thinkHard from the opening position for 200ms per iteration, with
+// progressive widening on or off, and reports how many nodes that allocated.
+void BM_progressiveWidening(benchmark::State &bmState) {
+  State::setProgressiveWidening(bmState.range(0));
+
+  uint64_t playouts = 0;
+  uint64_t nodes = 0;
+  for (auto _ : bmState) {
+    State root(/*parent=*/nullptr, Board(), Board::Player::One);
+    playouts += AI::thinkHard(&root, std::chrono::milliseconds(200));
+    nodes += root.numNodes();
+  }
+
+  using benchmark::Counter;
+  bmState.counters["playouts/s"] = Counter(playouts, Counter::kIsRate);
+  bmState.counters["nodes"] = Counter(nodes, Counter::kAvgIterations);
+  bmState.counters["nodes/kplayout"] = 1000.0 * nodes / playouts;
+  State::setProgressiveWidening(true);
+}
+
+BENCHMARK(BM_progressiveWidening)
+    ->Arg(0)
+    ->Arg(1)
+    ->ArgName("widening")
+    ->Iterations(5)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Follows a random cycle through 1M State-sized blocks, a stand-in for the
+// scattered reads of descents through a big tree, where TLB misses dominate.
+// args: 0 = blocks from operator new, 1 = from a NodePool on 4KB pages,
+// 2 = from a NodePool on huge pages.
+void BM_nodeMemory(benchmark::State &bmState) {
+  constexpr int kBlocks = 1 << 20;
+  constexpr int kHopsPerIteration = 1 << 16;
+  int source = bmState.range(0);
+
+  std::unique_ptr<NodePool> pool;
+  if (source > 0) {
+    pool = std::make_unique<NodePool>(
+        sizeof(State), NodePoolOptions{.hugePages = source == 2});
+  }
+  std::vector<void *> blocks(kBlocks);
+  for (auto &block : blocks) {
+    block = pool ? pool->allocate() : ::operator new(sizeof(State));
+  }
+  std::vector<int> order(kBlocks);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937(1));
+  for (int i = 0; i < kBlocks; i++) {
+    *static_cast<void **>(blocks[order[i]]) =
+        blocks[order[(i + 1) % kBlocks]];
+  }
+
+  void *p = blocks[order[0]];
+  for (auto _ : bmState) {
+    for (int i = 0; i < kHopsPerIteration; i++) {
+      p = *static_cast<void **>(p);
+    }
+    benchmark::DoNotOptimize(p);
+  }
+  bmState.SetItemsProcessed(bmState.iterations() * kHopsPerIteration);
+
+  if (pool) {
+    auto stats = pool->stats();
+    bmState.counters["chunks"] = stats.chunks;
+    bmState.counters["explicitHuge"] = stats.explicitHugeChunks;
+    bmState.counters["numaNodes"] = stats.numNodes;
+  } else {
+    for (auto *block : blocks) {
+      ::operator delete(block);
+    }
+  }
+}
+
+BENCHMARK(BM_nodeMemory)->DenseRange(0, 2)->ArgName("source");
+
+// Threads sharing one pool, each creating and discarding small subtrees'
+// worth of nodes, as expansion and the reclaimer do.
+void BM_nodePoolChurn(benchmark::State &bmState) {
+  constexpr int kBlocksPerIteration = 64;
+  static NodePool pool(sizeof(State));
+
+  std::array<void *, kBlocksPerIteration> blocks;
+  for (auto _ : bmState) {
+    for (auto &block : blocks) {
+      block = pool.allocate();
+    }
+    benchmark::DoNotOptimize(blocks.data());
+    for (auto *block : blocks) {
+      pool.deallocate(block);
+    }
+  }
+  bmState.SetItemsProcessed(bmState.iterations() * kBlocksPerIteration);
+}
+
+BENCHMARK(BM_nodePoolChurn)->ThreadRange(1, 64)->UseRealTime();
+
+// args: simulation threads, leaves per batch, queue depth in batches.
+void BM_thinkPipelined(benchmark::State &bmState) {
+  PipelineOptions options{.selectionThreads = 1,
+                          .simulationThreads =
+                              static_cast<int>(bmState.range(0)),
+                          .batchSize = static_cast<int>(bmState.range(1)),
+                          .queueDepth = static_cast<int>(bmState.range(2))};
+
+  PipelineStats total;
+  for (auto _ : bmState) {
+    State root(/*parent=*/nullptr, Board(), Board::Player::One);
+    auto stats =
+        AI::thinkPipelined(&root, std::chrono::milliseconds(200), options);
+    total.leavesSelected += stats.leavesSelected;
+    total.playouts += stats.playouts;
+    total.leavesBackpropagated += stats.leavesBackpropagated;
+    total.selectionStalls += stats.selectionStalls;
+    total.simulationStalls += stats.simulationStalls;
+  }
+
+  using benchmark::Counter;
+  bmState.counters["selected/s"] =
+      Counter(total.leavesSelected, Counter::kIsRate);
+  bmState.counters["playouts/s"] = Counter(total.playouts, Counter::kIsRate);
+  bmState.counters["backprop/s"] =
+      Counter(total.leavesBackpropagated, Counter::kIsRate);
+  bmState.counters["selStalls"] = total.selectionStalls;
+  bmState.counters["simStalls"] = total.simulationStalls;
+}
+
+BENCHMARK(BM_thinkPipelined)
+    ->ArgsProduct({{1, 4, 16, 63}, {4, 16, 64}, {4, 64}})
+    ->ArgNames({"simThreads", "batch", "depth"})
+    ->Iterations(5)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Searches each of kDecidedPositions until its root is solved or 2s pass,
+// with thinkHard alone or with proveHard on a second thread.
+void BM_proofSearch(benchmark::State &bmState) {
+  bool proofSearch = bmState.range(0);
+
+  uint64_t playouts = 0;
+  int solved = 0;
+  for (auto _ : bmState) {
+    for (const auto &bitboards : kDecidedPositions) {
+      Board board;
+      board.board_ = bitboards;
+      State root(/*parent=*/nullptr, board, board.nextPlayer());
+
+      std::thread prover;
+      if (proofSearch) {
+        prover = std::thread([&]() {
+          AI::proveHard(&root, std::chrono::seconds(2), ProofSearchOptions{});
+        });
+      }
+      playouts += AI::thinkHard(&root, std::chrono::seconds(2));
+      if (prover.joinable()) {
+        prover.join();
+      }
+      solved += root.winProb().solvedWinner() != Board::Player::None;
+    }
+  }
+
+  using benchmark::Counter;
+  bmState.counters["playouts"] = Counter(playouts, Counter::kAvgIterations);
+  bmState.counters["solved"] = Counter(solved, Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_proofSearch)
+    ->Arg(0)
+    ->Arg(1)
+    ->ArgName("proof")
+    ->Iterations(3)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+template <typename PlayoutT>
+void BM_playoutPolicy(benchmark::State &bmState) {
+  std::array<Board::Player, kPlayoutLanes> winners;
+  for (auto _ : bmState) {
+    batchMonteCarloTrials<Board, PlayoutT>(Board(), Board::Player::One,
+                                           winners.size(), winners.data());
+    benchmark::DoNotOptimize(winners);
+  }
+  bmState.SetItemsProcessed(bmState.iterations() * winners.size());
+}
+
+BENCHMARK_TEMPLATE(BM_playoutPolicy, UniformPlayout);
+BENCHMARK_TEMPLATE(BM_playoutPolicy, SafePlayout);
+BENCHMARK_TEMPLATE(BM_playoutPolicy, ThreatPlayout);
+
+// Thinks for 200ms on each of kDecidedPositions and checks with DfpnSolver
+// that the chosen move keeps the win for whichever side has it. Reports
+// playouts/s and how many of the moves were right.
+template <typename PolicyT>
+void BM_searchPolicy(benchmark::State &bmState) {
+  using PolicyAI = BasicAI<Board, PolicyT>;
+  DfpnSolver<Board> solver(/*tableBits=*/20);
+
+  uint64_t playouts = 0;
+  int correct = 0;
+  for (auto _ : bmState) {
+    for (const auto &bitboards : kDecidedPositions) {
+      Board board;
+      board.board_ = bitboards;
+      auto player = board.nextPlayer();
+      typename PolicyAI::State root(/*parent=*/nullptr, board, player);
+      playouts += PolicyAI::thinkHard(&root, std::chrono::milliseconds(200));
+
+      bmState.PauseTiming();
+      auto spot = root.pickMove();
+      Board next(board);
+      next.move(spot, player);
+      auto deadline = DfpnSolver<Board>::Clock::time_point::max();
+      auto opponent = Board::other(player);
+      // Right unless the move throws away a win.
+      bool winning = solver.solve(board, player, player, 1 << 24, deadline) ==
+                     DfpnSolver<Board>::Result::kProved;
+      correct += !winning || next.winner() == player ||
+                 solver.solve(next, opponent, player, 1 << 24, deadline) ==
+                     DfpnSolver<Board>::Result::kProved;
+      bmState.ResumeTiming();
+    }
+  }
+
+  using benchmark::Counter;
+  bmState.counters["playouts/s"] = Counter(playouts, Counter::kIsRate);
+  bmState.counters["correct"] = Counter(correct, Counter::kAvgIterations);
+}
+
+BENCHMARK_TEMPLATE(BM_searchPolicy, DefaultPolicy)
+    ->Iterations(3)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_searchPolicy, UniformPolicy)
+    ->Iterations(3)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_searchPolicy, ThreatPolicy)
+    ->Iterations(3)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_searchPolicy, UniformUcbPolicy)
+    ->Iterations(3)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_searchPolicy, SafeUcbPolicy)
+    ->Iterations(3)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_searchPolicy, ThreatUcbPolicy)
+    ->Iterations(3)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
+} // namespace ais::conn4
@@ -2,7 +2,11 @@
 
 #include <unistd.h>
 
+#include <cstring>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <grpc/grpc.h>
 #include <grpcpp/channel.h>
@@ -10,6 +14,8 @@
 #include <grpcpp/create_channel.h>
 #include <grpcpp/security/credentials.h>
 
+#include "ais/connect4Distributed.h"
+#include "ais/connect4GameLog.h"
 #include "proto/game.grpc.pb.h"
 
 std::unique_ptr<game::Connect4::Game>
@@ -57,7 +63,7 @@ waitForServerMove(game::Connect4Service::Stub *stub,
   }
 }
 
-int main() {
+int main(int argc, char **argv) {
   auto stub = game::Connect4Service::NewStub(grpc::CreateChannel(
       "localhost:50051", grpc::InsecureChannelCredentials()));
 
@@ -68,15 +74,60 @@ int main() {
       newGame(stub.get(), /*serverPlayer=*/serverPlayer, /*difficulty=*/5);
   auto ai = ais::conn4::AI(/*aiPlayer=*/aiPlayer, /*usecPerMove=*/3000000);
 
+  // Usage: connect4Client [snapshot path] [--workers=host:port,...]
+  //                       [--log=path] [--proof]
+  std::unique_ptr<ais::conn4::SearchCoordinator> coordinator;
+  std::unique_ptr<ais::conn4::GameLogWriter> log;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--log=", 6) == 0) {
+      log = std::make_unique<ais::conn4::GameLogWriter>(argv[i] + 6);
+    } else if (strcmp(argv[i], "--proof") == 0) {
+      ai.useProofSearch(ais::conn4::ProofSearchOptions{});
+    } else if (strncmp(argv[i], "--workers=", 10) == 0) {
+      std::vector<std::string> addresses;
+      std::stringstream list(argv[i] + 10);
+      for (std::string address; std::getline(list, address, ',');) {
+        addresses.push_back(address);
+      }
+      coordinator =
+          std::make_unique<ais::conn4::SearchCoordinator>(addresses);
+      ai.useMovePicker([&](const ais::conn4::State &root,
+                           ais::conn4::AI::Clock::duration budget) {
+        auto result =
+            coordinator->search(root.board(), root.playerToMove(), budget);
+        return result.bestMove(root.board(), root.playerToMove());
+      });
+    } else {
+      // Reuse the opening analysis from earlier games.
+      ai.useSnapshot(/*path=*/argv[i], /*maxNodes=*/1 << 20);
+    }
+  }
+
   int moveNum = 0;
   while (!ai.gameIsOver()) {
+    auto board = ai.state().board();
+    auto player = ai.state().playerToMove();
     if (moveNum % 2 == serverPlayer) {
       auto moveList = waitForServerMove(stub.get(), game.get(),
                                         /*serverPlayer=*/serverPlayer);
-      ai.makeServerMove(moveList->moves()[moveList->moves().size() - 1]);
+      const auto &move = moveList->moves()[moveList->moves().size() - 1];
+      ai.makeServerMove(move);
+      if (log) {
+        log->appendOpponentMove(
+            board, player,
+            ais::conn4::Board::Spot{.row = static_cast<int32_t>(move.row()),
+                                    .col = static_cast<int32_t>(move.col())});
+      }
     } else {
       auto move = ai.waitForMove();
       makeMove(stub.get(), game.get(), move->row(), move->col());
+      if (log) {
+        log->appendAIMove(
+            board, player,
+            ais::conn4::Board::Spot{.row = static_cast<int32_t>(move->row()),
+                                    .col = static_cast<int32_t>(move->col())},
+            ai.lastMoveStats());
+      }
     }
     moveNum++;
   }
@@ -0,0 +1,151 @@
+#include "ais/connect4Distributed.h"
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace ais::conn4 {
+
+game::Connect4::SearchUpdate toSearchUpdate(const SearchResult &result) {
+  game::Connect4::SearchUpdate update;
+  for (int col = 0; col < Board::kCols; col++) {
+    const auto &column = result.columns[col];
+    if (column.trials == 0 && column.solvedWinner == Board::Player::None) {
+      continue;
+    }
+    auto *stats = update.add_columns();
+    stats->set_col(col);
+    stats->set_trials(column.trials);
+    stats->set_winprob(column.winProb);
+    stats->set_solvedwinner(static_cast<uint32_t>(column.solvedWinner));
+  }
+  update.set_playouts(result.playouts);
+  return update;
+}
+
+SearchResult fromSearchUpdate(const game::Connect4::SearchUpdate &update) {
+  SearchResult result;
+  for (const auto &stats : update.columns()) {
+    if (stats.col() >= Board::kCols ||
+        stats.solvedwinner() > static_cast<uint32_t>(Board::Player::Draw)) {
+      continue;
+    }
+    auto &column = result.columns[stats.col()];
+    column.trials = stats.trials();
+    column.winProb = stats.winprob();
+    column.solvedWinner = static_cast<Board::Player>(stats.solvedwinner());
+  }
+  result.playouts = update.playouts();
+  return result;
+}
+
+grpc::Status
+SearchWorker::Search(grpc::ServerContext *context,
+                     const game::Connect4::SearchReq *req,
+                     grpc::ServerWriter<game::Connect4::SearchUpdate> *writer) {
+  Board board;
+  board.board_ = {req->playeroneboard(), req->playertwoboard()};
+  if (!board.boardIsLegal() || req->playertomove() > 1) {
+    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "illegal board");
+  }
+
+  State root(/*parent=*/nullptr, board,
+             static_cast<Board::Player>(req->playertomove()));
+  auto budget = std::chrono::microseconds(req->usecbudget());
+  auto deadline = AI::Clock::now() + budget;
+
+  std::atomic<uint64_t> playouts{0};
+  std::atomic<int> threadsRunning{0};
+  std::vector<std::thread> threads;
+  if (board.winner() == Board::Player::None) {
+    threadsRunning = numThreads_;
+    for (int i = 0; i < numThreads_; i++) {
+      threads.push_back(std::thread([&]() {
+        playouts += AI::thinkHard(&root, budget);
+        threadsRunning--;
+      }));
+    }
+  }
+
+  if (req->usecperupdate() > 0) {
+    auto interval = std::chrono::microseconds(req->usecperupdate());
+    for (auto next = AI::Clock::now() + interval; next < deadline;
+         next += interval) {
+      std::this_thread::sleep_until(next);
+      if (threadsRunning == 0 || context->IsCancelled()) {
+        break;
+      }
+      // Playouts are only counted once the threads finish, so intermediate
+      // updates carry just the per-column trials.
+      writer->Write(toSearchUpdate(collectSearchResult(root)));
+    }
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto result = collectSearchResult(root);
+  result.playouts = playouts;
+  auto update = toSearchUpdate(result);
+  update.set_final(true);
+  writer->Write(update);
+  return grpc::Status::OK;
+}
+
+SearchCoordinator::SearchCoordinator(
+    const std::vector<std::string> &workerAddresses) {
+  for (const auto &address : workerAddresses) {
+    stubs_.push_back(game::Connect4SearchService::NewStub(
+        grpc::CreateChannel(address, grpc::InsecureChannelCredentials())));
+  }
+}
+
+SearchResult SearchCoordinator::search(const Board &board,
+                                       Board::Player playerToMove,
+                                       AI::Clock::duration budget) {
+  game::Connect4::SearchReq req;
+  req.set_playeroneboard(board.board_[0]);
+  req.set_playertwoboard(board.board_[1]);
+  req.set_playertomove(static_cast<uint32_t>(playerToMove));
+  req.set_usecbudget(
+      std::chrono::duration_cast<std::chrono::microseconds>(budget).count());
+  req.set_usecperupdate(
+      std::chrono::duration_cast<std::chrono::microseconds>(kUpdateInterval)
+          .count());
+
+  auto deadline = std::chrono::system_clock::now() + budget + kGracePeriod;
+
+  std::mutex mutex;
+  SearchResult merged;
+  std::vector<std::thread> threads;
+  for (auto &stub : stubs_) {
+    threads.push_back(std::thread([&, stub = stub.get()]() {
+      grpc::ClientContext context;
+      context.set_deadline(deadline);
+      auto reader = stub->Search(&context, req);
+
+      SearchResult latest;
+      game::Connect4::SearchUpdate update;
+      while (reader->Read(&update)) {
+        latest = fromSearchUpdate(update);
+      }
+      auto status = reader->Finish();
+      if (!status.ok()) {
+        fprintf(stderr, "Search worker failed: %s\n",
+                status.error_message().c_str());
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      merged.merge(latest);
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  return merged;
+}
+
+} // namespace ais::conn4
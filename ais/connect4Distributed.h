@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+#include "ais/connect4AI.h"
+#include "ais/connect4SearchResult.h"
+#include "proto/game.grpc.pb.h"
+
+namespace ais::conn4 {
+
+game::Connect4::SearchUpdate toSearchUpdate(const SearchResult &result);
+SearchResult fromSearchUpdate(const game::Connect4::SearchUpdate &update);
+
+// Serves Connect4SearchService: each request gets a fresh tree searched by
+// numThreads thinkHard threads.
+class SearchWorker final : public game::Connect4SearchService::Service {
+public:
+  explicit SearchWorker(int numThreads) : numThreads_(numThreads) {}
+
+  grpc::Status
+  Search(grpc::ServerContext *context, const game::Connect4::SearchReq *req,
+         grpc::ServerWriter<game::Connect4::SearchUpdate> *writer) override;
+
+private:
+  const int numThreads_;
+};
+
+// Fans a search out to every worker and merges what they send back. A worker
+// that fails or misses the deadline contributes its last streamed update.
+class SearchCoordinator {
+public:
+  explicit SearchCoordinator(const std::vector<std::string> &workerAddresses);
+
+  SearchResult search(const Board &board, Board::Player playerToMove,
+                      AI::Clock::duration budget);
+
+  int numWorkers() const { return stubs_.size(); }
+
+  // How long past the budget to wait for a worker's final update.
+  static constexpr auto kGracePeriod = std::chrono::milliseconds(500);
+  static constexpr auto kUpdateInterval = std::chrono::milliseconds(100);
+
+private:
+  std::vector<std::unique_ptr<game::Connect4SearchService::Stub>> stubs_;
+};
+
+} // namespace ais::conn4
@@ -0,0 +1,115 @@
+#include "ais/connect4Distributed.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "ais/connect4Positions.h"
+#include "ais/connect4Proof.h"
+
+namespace {
+
+using ais::conn4::Board;
+using Solver = ais::conn4::DfpnSolver<Board>;
+
+struct Position {
+  Board board;
+  Board::Player playerToMove;
+  // The moves that keep the forced win, according to DfpnSolver.
+  std::vector<int> bestCols;
+};
+
+std::vector<Position> positions() {
+  Solver solver(/*tableBits=*/22);
+  auto deadline = Solver::Clock::time_point::max();
+
+  std::vector<Position> result;
+  auto add = [&](const std::array<uint64_t, 2> &bitboards) {
+    Position position;
+    position.board.board_ = bitboards;
+    position.playerToMove = position.board.nextPlayer();
+    auto player = position.playerToMove;
+    auto legalMoves = position.board.legalMoves();
+    for (int col = 0; col < Board::kCols; col++) {
+      int row = legalMoves.legalRowInCol[col];
+      if (row == Board::LegalMoves::kIllegal) {
+        continue;
+      }
+      Board next(position.board);
+      next.move(Board::Spot{.row = row, .col = col}, player);
+      if (next.winner() == player ||
+          solver.solve(next, Board::other(player), player, 1 << 24,
+                       deadline) == Solver::Result::kProved) {
+        position.bestCols.push_back(col);
+      }
+    }
+    result.push_back(std::move(position));
+  };
+
+  for (const auto &bitboards : ais::conn4::kDecidedPositions) {
+    add(bitboards);
+  }
+  for (const auto &bitboards : ais::conn4::kNarrowWinPositions) {
+    add(bitboards);
+  }
+  return result;
+}
+
+} // namespace
+
+// Usage: connect4DistributedEval <usecBudget> <worker address>...
+//
+// Searches each of the decided midgame positions (see connect4Positions.h)
+// with the first 1, 2, ..., N workers and reports the latency, how often a
+// move that keeps the forced win was picked and the playouts run.
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <usecBudget> <worker address>...\n", argv[0]);
+    return 1;
+  }
+
+  auto budget = std::chrono::microseconds(atoi(argv[1]));
+  std::vector<std::string> addresses(argv + 2, argv + argc);
+  auto testPositions = positions();
+
+  printf("%8s %12s %12s %10s %14s\n", "workers", "avg ms", "max ms",
+         "correct", "playouts/s");
+  for (size_t numWorkers = 1; numWorkers <= addresses.size(); numWorkers++) {
+    ais::conn4::SearchCoordinator coordinator(
+        {addresses.begin(), addresses.begin() + numWorkers});
+
+    double totalSeconds = 0.0;
+    double maxSeconds = 0.0;
+    int correct = 0;
+    uint64_t playouts = 0;
+    for (size_t i = 0; i < testPositions.size(); i++) {
+      const auto &position = testPositions[i];
+      auto start = std::chrono::steady_clock::now();
+      auto result =
+          coordinator.search(position.board, position.playerToMove, budget);
+      auto spot = result.bestMove(position.board, position.playerToMove);
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+
+      totalSeconds += elapsed.count();
+      maxSeconds = std::max(maxSeconds, elapsed.count());
+      playouts += result.playouts;
+      if (std::find(position.bestCols.begin(), position.bestCols.end(),
+                    spot.col) != position.bestCols.end()) {
+        correct++;
+      } else {
+        printf("  position %zu: picked column %d\n", i, spot.col);
+      }
+    }
+
+    printf("%8zu %12.1f %12.1f %6d/%-3zu %14.0f\n", numWorkers,
+           totalSeconds / testPositions.size() * 1e3, maxSeconds * 1e3,
+           correct, testPositions.size(), playouts / totalSeconds);
+  }
+
+  return 0;
+}
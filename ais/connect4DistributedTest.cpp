@@ -0,0 +1,126 @@
+#include "ais/connect4Distributed.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ais::conn4 {
+
+// Workers served from this process on ports picked by the OS.
+class LocalWorkers {
+public:
+  explicit LocalWorkers(int numWorkers) {
+    for (int i = 0; i < numWorkers; i++) {
+      workers_.push_back(std::make_unique<SearchWorker>(/*numThreads=*/1));
+      int port = 0;
+      grpc::ServerBuilder builder;
+      builder.AddListeningPort("localhost:0", grpc::InsecureServerCredentials(),
+                               &port);
+      builder.RegisterService(workers_.back().get());
+      servers_.push_back(builder.BuildAndStart());
+      addresses_.push_back("localhost:" + std::to_string(port));
+    }
+  }
+
+  ~LocalWorkers() {
+    for (auto &server : servers_) {
+      server->Shutdown();
+    }
+  }
+
+  const std::vector<std::string> &addresses() const { return addresses_; }
+
+private:
+  std::vector<std::unique_ptr<SearchWorker>> workers_;
+  std::vector<std::unique_ptr<grpc::Server>> servers_;
+  std::vector<std::string> addresses_;
+};
+
+TEST(SearchResult, merge) {
+  SearchResult a;
+  a.columns[0] = ColumnStats{.trials = 100, .winProb = 0.2};
+  a.columns[1] = ColumnStats{.trials = 100, .winProb = 0.9};
+  a.playouts = 200;
+
+  SearchResult b;
+  b.columns[0] = ColumnStats{.trials = 300, .winProb = 0.6};
+  b.columns[1] = ColumnStats{.trials = 100,
+                             .winProb = 0.0,
+                             .solvedWinner = Board::Player::Two};
+  b.playouts = 400;
+
+  a.merge(b);
+  EXPECT_EQ(a.columns[0].trials, 400);
+  EXPECT_DOUBLE_EQ(a.columns[0].winProb, 0.5);
+  EXPECT_EQ(a.columns[1].solvedWinner, Board::Player::Two);
+  EXPECT_EQ(a.playouts, 600);
+
+  // Column 1 has the higher average but was proven lost by one worker.
+  EXPECT_EQ(a.bestMove(Board(), Board::Player::One).col, 0);
+}
+
+TEST(SearchResult, protoRoundTrip) {
+  SearchResult result;
+  result.columns[3] = ColumnStats{.trials = 1234,
+                                  .winProb = 0.75,
+                                  .solvedWinner = Board::Player::One};
+  result.playouts = 5678;
+
+  auto copy = fromSearchUpdate(toSearchUpdate(result));
+  EXPECT_EQ(copy.columns[3].trials, 1234);
+  EXPECT_DOUBLE_EQ(copy.columns[3].winProb, 0.75);
+  EXPECT_EQ(copy.columns[3].solvedWinner, Board::Player::One);
+  EXPECT_EQ(copy.columns[0].trials, 0);
+  EXPECT_EQ(copy.playouts, 5678);
+}
+
+TEST(SearchCoordinator, findsDoubleThreat) {
+  LocalWorkers workers(/*numWorkers=*/2);
+  SearchCoordinator coordinator(workers.addresses());
+
+  Board board("       \n"
+              "       \n"
+              "       \n"
+              "       \n"
+              "   OO  \n"
+              "   XX  \n");
+  auto result = coordinator.search(board, Board::Player::One,
+                                   std::chrono::milliseconds(500));
+
+  EXPECT_GT(result.playouts, 0);
+  auto col = result.bestMove(board, Board::Player::One).col;
+  EXPECT_TRUE(col == 2 || col == 5) << col;
+}
+
+TEST(SearchCoordinator, unreachableWorkerIsSkipped) {
+  LocalWorkers workers(/*numWorkers=*/1);
+  auto addresses = workers.addresses();
+  addresses.push_back("localhost:1");
+  SearchCoordinator coordinator(addresses);
+
+  auto result = coordinator.search(Board(), Board::Player::One,
+                                   std::chrono::milliseconds(200));
+  EXPECT_GT(result.playouts, 0);
+  EXPECT_NE(result.bestMove(Board(), Board::Player::One), Board::kIllegalSpot);
+}
+
+TEST(SearchWorker, rejectsIllegalBoard) {
+  LocalWorkers workers(/*numWorkers=*/1);
+  auto stub = game::Connect4SearchService::NewStub(grpc::CreateChannel(
+      workers.addresses()[0], grpc::InsecureChannelCredentials()));
+
+  game::Connect4::SearchReq req;
+  req.set_playeroneboard(0b11);
+  req.set_playertwoboard(0);
+  req.set_usecbudget(1000);
+
+  grpc::ClientContext context;
+  auto reader = stub->Search(&context, req);
+  game::Connect4::SearchUpdate update;
+  EXPECT_FALSE(reader->Read(&update));
+  EXPECT_EQ(reader->Finish().error_code(), grpc::StatusCode::INVALID_ARGUMENT);
+}
+
+} // namespace ais::conn4
@@ -0,0 +1,170 @@
+#include "ais/connect4GameLog.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace ais::conn4 {
+
+namespace {
+
+bool headerMatches(const GameLogHeader &header) {
+  return header.magic == GameLogHeader::kMagic &&
+         header.version == GameLogHeader::kVersion &&
+         header.rows == Board::kRows && header.cols == Board::kCols &&
+         header.inARow == Board::kInARow;
+}
+
+} // namespace
+
+uint32_t GameLogRecord::computeChecksum() const {
+  uint32_t hash = 2166136261u;
+  auto *bytes = reinterpret_cast<const uint8_t *>(this);
+  for (size_t i = 0; i < offsetof(GameLogRecord, checksum); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+GameLogWriter::GameLogWriter(const std::string &path)
+    : out_(path, std::ios::binary | std::ios::app),
+      gameId_(std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::system_clock::now().time_since_epoch())
+                  .count()) {
+  // In append mode the put position only moves to the end on the first
+  // write, so ask the end explicitly.
+  out_.seekp(0, std::ios::end);
+  auto size = static_cast<size_t>(out_.tellp());
+  if (size > 0 && size < sizeof(GameLogHeader)) {
+    // A crash while the header was being written. Nothing after it can have
+    // been written, so start the file over. If that fails, refuse to write
+    // records that readers would reject anyway.
+    if (::truncate(path.c_str(), 0) != 0) {
+      out_.setstate(std::ios::failbit);
+      return;
+    }
+    out_.seekp(0);
+    size = 0;
+  }
+  if (size == 0) {
+    GameLogHeader header;
+    out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  } else if (size > sizeof(GameLogHeader)) {
+    // Pad out a record torn by a crash so that the records after it stay
+    // aligned. Its checksum won't match, so readers skip it.
+    size_t torn = (size - sizeof(GameLogHeader)) % sizeof(GameLogRecord);
+    if (torn != 0) {
+      std::vector<char> padding(sizeof(GameLogRecord) - torn);
+      out_.write(padding.data(), padding.size());
+    }
+  }
+  out_.flush();
+}
+
+void GameLogWriter::append(GameLogRecord record, const Board &boardBefore,
+                           Board::Player player, Board::Spot spot) {
+  record.gameId = gameId_;
+  record.moveNum = moveNum_++;
+  record.row = spot.row;
+  record.col = spot.col;
+  record.player = static_cast<uint8_t>(player);
+  record.board[0] = boardBefore.board_[0];
+  record.board[1] = boardBefore.board_[1];
+
+  Board after(boardBefore);
+  after.move(spot, player);
+  record.winner = static_cast<uint8_t>(after.winner());
+  record.checksum = record.computeChecksum();
+
+  out_.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  out_.flush();
+}
+
+void GameLogWriter::appendAIMove(const Board &boardBefore,
+                                 Board::Player player, Board::Spot spot,
+                                 const AI::MoveStats &stats) {
+  GameLogRecord record;
+  record.byAI = 1;
+  record.usecThink =
+      std::chrono::duration_cast<std::chrono::microseconds>(stats.thinkTime)
+          .count();
+  record.playouts = stats.playouts;
+  for (int col = 0; col < GameLogRecord::kMaxCols; col++) {
+    record.colProbs[col] = col < Board::kCols
+                               ? stats.colProbs[col]
+                               : std::numeric_limits<float>::quiet_NaN();
+  }
+  append(record, boardBefore, player, spot);
+}
+
+void GameLogWriter::appendOpponentMove(const Board &boardBefore,
+                                       Board::Player player,
+                                       Board::Spot spot) {
+  GameLogRecord record;
+  for (auto &prob : record.colProbs) {
+    prob = std::numeric_limits<float>::quiet_NaN();
+  }
+  append(record, boardBefore, player, spot);
+}
+
+bool readGameLog(std::istream &in,
+                 const std::function<void(const GameLogRecord &)> &onRecord) {
+  GameLogHeader header;
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      !headerMatches(header)) {
+    return false;
+  }
+
+  GameLogRecord record;
+  while (in.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    if (record.valid()) {
+      onRecord(record);
+    }
+  }
+  return true;
+}
+
+MappedGameLog::MappedGameLog(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(GameLogHeader))) {
+    close(fd);
+    return;
+  }
+
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return;
+  }
+
+  if (!headerMatches(*static_cast<const GameLogHeader *>(data))) {
+    munmap(data, st.st_size);
+    return;
+  }
+
+  data_ = data;
+  size_ = st.st_size;
+  records_ = std::span<const GameLogRecord>(
+      reinterpret_cast<const GameLogRecord *>(static_cast<const char *>(data) +
+                                              sizeof(GameLogHeader)),
+      (size_ - sizeof(GameLogHeader)) / sizeof(GameLogRecord));
+}
+
+MappedGameLog::~MappedGameLog() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
+
+} // namespace ais::conn4
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <span>
+#include <string>
+#include <type_traits>
+
+#include "ais/connect4AI.h"
+
+namespace ais::conn4 {
+
+// An append-only log of the games played, one fixed-size record per move.
+//
+// The file is a GameLogHeader followed by GameLogRecords, all little-endian
+// and 8-byte aligned. Records are self-contained (each carries the position
+// before the move) so the log can be read as a stream, scanned through mmap,
+// or cut at any record boundary. The next writer pads a record torn by a
+// crash out to a full record, and readers skip records that aren't valid().
+struct GameLogHeader {
+  static constexpr uint32_t kMagic = 0x4c473443; // "C4GL"
+  static constexpr uint16_t kVersion = 1;
+
+  uint32_t magic{kMagic};
+  uint16_t version{kVersion};
+  uint8_t rows{Board::kRows};
+  uint8_t cols{Board::kCols};
+  uint8_t inARow{Board::kInARow};
+  uint8_t reserved[7]{};
+};
+
+struct GameLogRecord {
+  static constexpr uint32_t kMagic = 0x564d3443; // "C4MV"
+  static constexpr int kMaxCols = 8;
+
+  uint32_t magic{kMagic};
+  // Number of moves made before this one.
+  uint8_t moveNum{0};
+  uint8_t row{0};
+  uint8_t col{0};
+  // Board::Player values.
+  uint8_t player{0};
+  // Board::Player::None until the move ends the game.
+  uint8_t winner{static_cast<uint8_t>(Board::Player::None)};
+  // 1 if the move was chosen by this engine, 0 if it came from the opponent.
+  uint8_t byAI{0};
+  uint8_t reserved[6]{};
+  // Identifies the game; all of a game's records share it.
+  uint64_t gameId{0};
+  // The position before the move.
+  uint64_t board[2]{};
+  uint64_t usecThink{0};
+  uint64_t playouts{0};
+  // The win probability of each column for the player moving, NaN where
+  // unknown.
+  float colProbs[kMaxCols]{};
+  // FNV-1a of the bytes before it, so that a torn or corrupt record is
+  // detected even though its magic made it to disk.
+  uint32_t checksum{0};
+  uint32_t reserved2{0};
+
+  uint32_t computeChecksum() const;
+  bool valid() const {
+    return magic == kMagic && checksum == computeChecksum();
+  }
+};
+
+static_assert(std::endian::native == std::endian::little);
+static_assert(sizeof(GameLogHeader) == 16);
+static_assert(sizeof(GameLogRecord) == 96);
+static_assert(std::is_trivially_copyable_v<GameLogRecord>);
+static_assert(Board::kCols <= GameLogRecord::kMaxCols);
+static_assert(sizeof(Board::Bits) == sizeof(uint64_t));
+
+class GameLogWriter {
+public:
+  // Appends to `path`, writing the header if the file is new or its header was
+  // torn. A new game id is picked for the records written through this
+  // writer.
+  explicit GameLogWriter(const std::string &path);
+
+  bool ok() const { return out_.good(); }
+
+  uint64_t gameId() const { return gameId_; }
+
+  // Each record is flushed as soon as it is appended.
+  void appendAIMove(const Board &boardBefore, Board::Player player,
+                    Board::Spot spot, const AI::MoveStats &stats);
+
+  void appendOpponentMove(const Board &boardBefore, Board::Player player,
+                          Board::Spot spot);
+
+private:
+  void append(GameLogRecord record, const Board &boardBefore,
+              Board::Player player, Board::Spot spot);
+
+  std::ofstream out_;
+  uint64_t gameId_;
+  uint8_t moveNum_{0};
+};
+
+// Calls onRecord for each valid record in the stream. Returns false if the
+// stream isn't a game log for this geometry.
+bool readGameLog(std::istream &in,
+                 const std::function<void(const GameLogRecord &)> &onRecord);
+
+// A read-only mapping of a whole log file.
+class MappedGameLog {
+public:
+  explicit MappedGameLog(const std::string &path);
+  ~MappedGameLog();
+
+  MappedGameLog(const MappedGameLog &) = delete;
+  MappedGameLog &operator=(const MappedGameLog &) = delete;
+
+  // False if the file couldn't be mapped or isn't a game log for this
+  // geometry. Unlike readGameLog, records() includes invalid records; check
+  // valid().
+  bool ok() const { return data_ != nullptr; }
+
+  std::span<const GameLogRecord> records() const { return records_; }
+
+private:
+  void *data_{nullptr};
+  size_t size_{0};
+  std::span<const GameLogRecord> records_;
+};
+
+} // namespace ais::conn4
@@ -0,0 +1,148 @@
+#include "ais/connect4GameLog.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ais::conn4 {
+
+std::string logPath(const char *name) {
+  std::string path = testing::TempDir() + name;
+  std::remove(path.c_str());
+  return path;
+}
+
+// Plays the AI against an opponent that always plays column 0, or column 1
+// once column 0 is full, logging every move.
+void playLoggedMoves(const std::string &path, int numMoves) {
+  GameLogWriter log(path);
+  ASSERT_TRUE(log.ok());
+
+  AI ai(/*aiPlayer=*/0, /*usecPerMove=*/100000);
+  for (int i = 0; i < numMoves; i++) {
+    auto board = ai.state().board();
+    auto player = ai.state().playerToMove();
+    if (i % 2 == 0) {
+      auto move = ai.waitForMove();
+      log.appendAIMove(board, player,
+                       Board::Spot{.row = static_cast<int32_t>(move->row()),
+                                   .col = static_cast<int32_t>(move->col())},
+                       ai.lastMoveStats());
+    } else {
+      int col = (ai.state().board().legalMoves().legalRowInCol[0] ==
+                 Board::LegalMoves::kIllegal)
+                    ? 1
+                    : 0;
+      Board::Spot spot{.row = board.legalMoves().legalRowInCol[col],
+                       .col = col};
+      game::Connect4::Move move;
+      move.set_row(spot.row);
+      move.set_col(spot.col);
+      ai.makeServerMove(move);
+      log.appendOpponentMove(board, player, spot);
+    }
+  }
+}
+
+TEST(GameLog, roundTrip) {
+  auto path = logPath("roundTrip.c4log");
+  playLoggedMoves(path, /*numMoves=*/4);
+
+  std::vector<GameLogRecord> records;
+  std::ifstream in(path, std::ios::binary);
+  ASSERT_TRUE(readGameLog(
+      in, [&](const GameLogRecord &record) { records.push_back(record); }));
+  ASSERT_EQ(records.size(), 4);
+
+  Board board;
+  for (int i = 0; i < static_cast<int>(records.size()); i++) {
+    const auto &record = records[i];
+    EXPECT_EQ(record.gameId, records[0].gameId);
+    EXPECT_EQ(record.moveNum, i);
+    EXPECT_EQ(record.byAI, i % 2 == 0);
+    EXPECT_EQ(record.player, i % 2);
+    EXPECT_EQ(record.board[0], board.board_[0]);
+    EXPECT_EQ(record.board[1], board.board_[1]);
+    EXPECT_EQ(record.winner, static_cast<uint8_t>(Board::Player::None));
+    if (record.byAI) {
+      EXPECT_GT(record.usecThink, 0);
+      EXPECT_GT(record.playouts, 0);
+      EXPECT_FALSE(std::isnan(record.colProbs[record.col]));
+    } else {
+      EXPECT_EQ(record.playouts, 0);
+      EXPECT_TRUE(std::isnan(record.colProbs[0]));
+    }
+    board.move({.row = record.row, .col = record.col},
+               static_cast<Board::Player>(record.player));
+  }
+
+  MappedGameLog mapped(path);
+  ASSERT_TRUE(mapped.ok());
+  ASSERT_EQ(mapped.records().size(), records.size());
+  EXPECT_EQ(mapped.records()[3].col, records[3].col);
+  EXPECT_EQ(mapped.records()[3].gameId, records[3].gameId);
+}
+
+TEST(GameLog, appendsGamesAndSkipsTornRecords) {
+  auto path = logPath("torn.c4log");
+  playLoggedMoves(path, /*numMoves=*/2);
+  {
+    // A crash in the middle of writing a record.
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out.write("C4MV torn", 9);
+  }
+  playLoggedMoves(path, /*numMoves=*/2);
+
+  std::vector<GameLogRecord> records;
+  std::ifstream in(path, std::ios::binary);
+  ASSERT_TRUE(readGameLog(
+      in, [&](const GameLogRecord &record) { records.push_back(record); }));
+  ASSERT_EQ(records.size(), 4);
+  EXPECT_EQ(records[1].moveNum, 1);
+  EXPECT_EQ(records[2].moveNum, 0);
+  EXPECT_NE(records[2].gameId, records[1].gameId);
+
+  MappedGameLog mapped(path);
+  ASSERT_TRUE(mapped.ok());
+  ASSERT_EQ(mapped.records().size(), 5);
+  EXPECT_FALSE(mapped.records()[2].valid());
+  EXPECT_EQ(mapped.records()[3].moveNum, 0);
+}
+
+TEST(GameLog, rewritesTornHeader) {
+  auto path = logPath("tornHeader.c4log");
+  {
+    // A crash in the middle of writing the header of a new log.
+    std::ofstream out(path, std::ios::binary);
+    out.write("C4G", 3);
+  }
+  playLoggedMoves(path, /*numMoves=*/2);
+
+  std::vector<GameLogRecord> records;
+  std::ifstream in(path, std::ios::binary);
+  ASSERT_TRUE(readGameLog(
+      in, [&](const GameLogRecord &record) { records.push_back(record); }));
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0].moveNum, 0);
+
+  MappedGameLog mapped(path);
+  ASSERT_TRUE(mapped.ok());
+  EXPECT_EQ(mapped.records().size(), 2);
+}
+
+TEST(GameLog, rejectsOtherFiles) {
+  std::istringstream in("not a game log, just some text");
+  EXPECT_FALSE(readGameLog(in, [](const GameLogRecord &) {}));
+
+  auto path = logPath("notALog.c4log");
+  std::ofstream(path) << "not a game log, just some text";
+  EXPECT_FALSE(MappedGameLog(path).ok());
+  EXPECT_FALSE(MappedGameLog(logPath("missing.c4log")).ok());
+}
+
+} // namespace ais::conn4
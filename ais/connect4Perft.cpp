@@ -0,0 +1,175 @@
+#include "ais/connect4Perft.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace ais::conn4 {
+namespace {
+
+template <typename BoardT> class TranspositionTable {
+public:
+  static constexpr size_t kNumEntries = 1 << 20;
+
+  TranspositionTable() : entries_(kNumEntries) {}
+
+  // Returns nullptr if the count isn't known.
+  const uint64_t *find(const BoardT &board, int depth) const {
+    const auto &entry = entries_[idx(board, depth)];
+    if (entry.depth != depth || entry.board != board.board_) {
+      return nullptr;
+    }
+    return &entry.count;
+  }
+
+  void insert(const BoardT &board, int depth, uint64_t count) {
+    auto &entry = entries_[idx(board, depth)];
+    entry.board = board.board_;
+    entry.depth = depth;
+    entry.count = count;
+  }
+
+private:
+  struct Entry {
+    std::array<typename BoardT::Bits, 2> board{};
+    uint64_t count{0};
+    int depth{-1};
+  };
+
+  static size_t idx(const BoardT &board, int depth) {
+    uint64_t h = depth;
+    for (auto bits : board.board_) {
+      if constexpr (sizeof(bits) > sizeof(uint64_t)) {
+        h = (h ^ static_cast<uint64_t>(bits >> 64)) * 0x9e3779b97f4a7c15ULL;
+      }
+      h = (h ^ static_cast<uint64_t>(bits)) * 0x9e3779b97f4a7c15ULL;
+    }
+    return (h >> 32) % kNumEntries;
+  }
+
+  std::vector<Entry> entries_;
+};
+
+template <typename BoardT>
+uint64_t perftImpl(const BoardT &board, BoardBase::Player player, int depth,
+                   TranspositionTable<BoardT> *tt) {
+  if (depth == 0) {
+    return 1;
+  }
+  if (board.winner() != BoardBase::Player::None) {
+    return 0;
+  }
+
+  auto legal = board.legalMoves();
+  if (depth == 1) {
+    uint64_t count = 0;
+    for (int row : legal.legalRowInCol) {
+      count += (row != BoardT::LegalMoves::kIllegal);
+    }
+    return count;
+  }
+
+  if (tt) {
+    if (const uint64_t *count = tt->find(board, depth)) {
+      return *count;
+    }
+  }
+
+  uint64_t count = 0;
+  for (int col = 0; col < BoardT::kCols; col++) {
+    int row = legal.legalRowInCol[col];
+    if (row == BoardT::LegalMoves::kIllegal) {
+      continue;
+    }
+    BoardT b(board);
+    b.move(BoardBase::Spot{.row = row, .col = col}, player);
+    count += perftImpl(b, BoardBase::other(player), depth - 1, tt);
+  }
+
+  if (tt) {
+    tt->insert(board, depth, count);
+  }
+  return count;
+}
+
+// Collects the positions exactly `depth` moves after `board` so that they can
+// be handed out to workers.
+template <typename BoardT>
+void collectPositions(const BoardT &board, BoardBase::Player player, int depth,
+                      std::vector<BoardT> *positions) {
+  if (depth == 0) {
+    positions->push_back(board);
+    return;
+  }
+  if (board.winner() != BoardBase::Player::None) {
+    return;
+  }
+
+  auto legal = board.legalMoves();
+  for (int col = 0; col < BoardT::kCols; col++) {
+    int row = legal.legalRowInCol[col];
+    if (row == BoardT::LegalMoves::kIllegal) {
+      continue;
+    }
+    BoardT b(board);
+    b.move(BoardBase::Spot{.row = row, .col = col}, player);
+    collectPositions(b, BoardBase::other(player), depth - 1, positions);
+  }
+}
+
+} // namespace
+
+template <typename BoardT>
+uint64_t perft(const BoardT &board, int depth, const PerftOptions &options) {
+  constexpr int kSplitDepth = 2;
+
+  if (options.numThreads <= 1 || depth <= kSplitDepth) {
+    std::unique_ptr<TranspositionTable<BoardT>> tt;
+    if (options.transpositions) {
+      tt = std::make_unique<TranspositionTable<BoardT>>();
+    }
+    return perftImpl(board, board.nextPlayer(), depth, tt.get());
+  }
+
+  std::vector<BoardT> positions;
+  collectPositions(board, board.nextPlayer(), kSplitDepth, &positions);
+
+  std::atomic<size_t> nextPosition{0};
+  std::atomic<uint64_t> total{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.numThreads; i++) {
+    threads.push_back(std::thread([&]() {
+      std::unique_ptr<TranspositionTable<BoardT>> tt;
+      if (options.transpositions) {
+        tt = std::make_unique<TranspositionTable<BoardT>>();
+      }
+
+      uint64_t count = 0;
+      while (true) {
+        size_t idx = nextPosition.fetch_add(1, std::memory_order_relaxed);
+        if (idx >= positions.size()) {
+          break;
+        }
+        const BoardT &b = positions[idx];
+        count += perftImpl(b, b.nextPlayer(), depth - kSplitDepth, tt.get());
+      }
+      total.fetch_add(count, std::memory_order_relaxed);
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  return total.load(std::memory_order_relaxed);
+}
+
+template uint64_t perft(const BasicBoard<6, 7, 4> &, int,
+                        const PerftOptions &);
+template uint64_t perft(const BasicBoard<7, 8, 4> &, int,
+                        const PerftOptions &);
+template uint64_t perft(const BasicBoard<5, 4, 4> &, int,
+                        const PerftOptions &);
+template uint64_t perft(const BasicBoard<8, 9, 5> &, int,
+                        const PerftOptions &);
+
+} // namespace ais::conn4
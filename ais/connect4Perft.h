@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ais/connect4AI.h"
+
+namespace ais::conn4 {
+
+struct PerftOptions {
+  int numThreads{1};
+  // Reuse counts of positions already reached through a different move order.
+  bool transpositions{false};
+};
+
+// Counts the positions exactly `depth` moves after `board`, using only
+// legalMoves, move and winner. A finished game has no successors, so a win
+// before `depth` contributes nothing. With several threads, the positions a
+// few moves deep are split between workers.
+template <typename BoardT>
+uint64_t perft(const BoardT &board, int depth,
+               const PerftOptions &options = PerftOptions{});
+
+extern template uint64_t perft(const BasicBoard<6, 7, 4> &, int,
+                               const PerftOptions &);
+extern template uint64_t perft(const BasicBoard<7, 8, 4> &, int,
+                               const PerftOptions &);
+extern template uint64_t perft(const BasicBoard<5, 4, 4> &, int,
+                               const PerftOptions &);
+extern template uint64_t perft(const BasicBoard<8, 9, 5> &, int,
+                               const PerftOptions &);
+
+} // namespace ais::conn4
@@ -0,0 +1,59 @@
+#include "ais/connect4Perft.h"
+
+#include <array>
+
+#include "gtest/gtest.h"
+
+namespace ais::conn4 {
+
+// No game can end and no column can fill before the 7th move, so the counts
+// up to depth 6 are powers of 7. At depth 7 the 7 positions with a full column
+// lose a move each. Depths 8 and 9 are the published connect-4 perft counts.
+constexpr std::array<uint64_t, 10> kConnect4Perft = {
+    1, 7, 49, 343, 2401, 16807, 117649, 823536, 5673234, 39394572,
+};
+
+TEST(Perft, connect4) {
+  for (size_t depth = 0; depth < kConnect4Perft.size(); depth++) {
+    EXPECT_EQ(perft(Board(), depth), kConnect4Perft[depth]) << depth;
+  }
+}
+
+TEST(Perft, threadsAndTranspositionsAgree) {
+  for (size_t depth = 0; depth < kConnect4Perft.size(); depth++) {
+    for (bool transpositions : {false, true}) {
+      PerftOptions options{.numThreads = 4, .transpositions = transpositions};
+      EXPECT_EQ(perft(Board(), depth, options), kConnect4Perft[depth])
+          << depth;
+    }
+  }
+}
+
+TEST(Perft, finishedGame) {
+  Board b("       \n"
+          "       \n"
+          "       \n"
+          "X      \n"
+          "XO     \n"
+          "XOO X  \n");
+  ASSERT_EQ(b.nextPlayer(), Board::Player::Two);
+  EXPECT_EQ(perft(b, 1), 7);
+
+  b.move(Board::Spot{.row = 1, .col = 2}, Board::Player::Two);
+  b.move(Board::Spot{.row = 3, .col = 0}, Board::Player::One);
+  EXPECT_EQ(perft(b, 0), 1);
+  EXPECT_EQ(perft(b, 1), 0);
+}
+
+TEST(Perft, otherGeometries) {
+  // 5x4 can't end before the 7th move either; the 4 columns fill after 5.
+  using SmallBoard = BasicBoard<5, 4, 4>;
+  EXPECT_EQ(perft(SmallBoard(), 5), 1024);
+  EXPECT_EQ(perft(SmallBoard(), 6), 4096 - 4);
+
+  using Connect5 = BasicBoard<8, 9, 5>;
+  EXPECT_EQ(perft(Connect5(), 4), 6561);
+  EXPECT_EQ(perft(Connect5(), 5, PerftOptions{.numThreads = 2}), 59049);
+}
+
+} // namespace ais::conn4
@@ -0,0 +1,211 @@
+#include "ais/connect4AI.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ais/boundedQueue.h"
+#include "ais/connect4Playout.h"
+#include "ais/connect4Policy.h"
+
+namespace ais::conn4 {
+namespace {
+
+constexpr int kMaxBatchSize = 64;
+
+template <typename StateT> struct LeafBatch {
+  int size{0};
+  std::array<StateT *, kMaxBatchSize> leaves;
+};
+
+} // namespace
+
+void PipelineStats::print() const {
+  printf("pipeline: %.0f leaves/s selected, %.0f playouts/s simulated, "
+         "%.0f leaves/s backpropagated, %llu selection stalls, "
+         "%llu simulation stalls\n",
+         leavesSelected / seconds, playouts / seconds,
+         leavesBackpropagated / seconds,
+         static_cast<unsigned long long>(selectionStalls),
+         static_cast<unsigned long long>(simulationStalls));
+}
+
+template <typename BoardT, typename PolicyT>
+/*static*/
+PipelineStats
+BasicAI<BoardT, PolicyT>::thinkPipelined(State *root,
+                                         Clock::duration durationPerMove,
+                                         const PipelineOptions &options) {
+  using Batch = LeafBatch<State>;
+
+  auto start = Clock::now();
+  auto deadline = start + durationPerMove;
+  int batchSize = std::clamp(options.batchSize, 1, kMaxBatchSize);
+  int playoutsPerLeaf = std::max(options.playoutsPerLeaf, 1);
+
+  BoundedQueue<Batch> toSimulate(options.queueDepth);
+  BoundedQueue<Batch> toBackpropagate(options.queueDepth);
+  std::atomic<int> selectionThreadsLeft{options.selectionThreads};
+
+  std::atomic<uint64_t> leavesSelected{0};
+  std::atomic<uint64_t> playouts{0};
+  std::atomic<uint64_t> leavesBackpropagated{0};
+  std::atomic<uint64_t> selectionStalls{0};
+  std::atomic<uint64_t> simulationStalls{0};
+
+  auto backpropagate = [&](const Batch &batch) {
+    for (int i = 0; i < batch.size; i++) {
+      batch.leaves[i]->updateProbabilities();
+      batch.leaves[i]->removeVirtualLoss();
+    }
+    leavesBackpropagated.fetch_add(batch.size, std::memory_order_relaxed);
+  };
+
+  // Returns false if there was nothing to backpropagate.
+  auto drainResults = [&]() {
+    Batch batch;
+    bool any = false;
+    while (toBackpropagate.tryPop(&batch)) {
+      backpropagate(batch);
+      any = true;
+    }
+    return any;
+  };
+
+  auto isFinished = [&]() {
+    auto wp = root->winProb().prob(root->playerToMove());
+    return Clock::now() >= deadline || wp == 0.0 || wp == 1.0;
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.selectionThreads; i++) {
+    threads.push_back(std::thread([&]() {
+      std::random_device rd;
+      std::mt19937 gen(rd());
+      Batch batch;
+      uint64_t selected = 0;
+      uint64_t stalls = 0;
+
+      while (!isFinished()) {
+        drainResults();
+
+        auto *leaf = root->selectLeaf(&gen, playoutsPerLeaf);
+        if (leaf == nullptr) {
+          continue;
+        }
+        leaf->addVirtualLoss();
+        batch.leaves[batch.size++] = leaf;
+        selected++;
+        if (batch.size < batchSize) {
+          continue;
+        }
+
+        // Keep backpropagating while the simulation queue is full, otherwise
+        // the simulation threads could block on a full result queue.
+        bool pushed;
+        while (!(pushed = toSimulate.tryPush(batch)) && !isFinished()) {
+          stalls++;
+          if (!drainResults()) {
+            std::this_thread::yield();
+          }
+        }
+        if (pushed) {
+          batch.size = 0;
+        }
+      }
+
+      for (int i = 0; i < batch.size; i++) {
+        batch.leaves[i]->removeVirtualLoss();
+      }
+      leavesSelected.fetch_add(selected, std::memory_order_relaxed);
+      selectionStalls.fetch_add(stalls, std::memory_order_relaxed);
+      selectionThreadsLeft.fetch_sub(1, std::memory_order_release);
+    }));
+  }
+
+  for (int i = 0; i < options.simulationThreads; i++) {
+    threads.push_back(std::thread([&]() {
+      std::vector<BoardBase::Player> winners(playoutsPerLeaf);
+      Batch batch;
+      uint64_t simulated = 0;
+      uint64_t stalls = 0;
+
+      while (selectionThreadsLeft.load(std::memory_order_acquire) > 0) {
+        if (!toSimulate.tryPop(&batch)) {
+          stalls++;
+          std::this_thread::yield();
+          continue;
+        }
+
+        for (int i = 0; i < batch.size; i++) {
+          auto *leaf = batch.leaves[i];
+          batchMonteCarloTrials<BoardT, typename PolicyT::Playout>(
+              leaf->board(), leaf->playerToMove(), playoutsPerLeaf,
+              winners.data());
+          for (auto winner : winners) {
+            leaf->recordMonteCarloResult(winner);
+          }
+        }
+        simulated += batch.size * playoutsPerLeaf;
+
+        while (!toBackpropagate.tryPush(batch)) {
+          // Nobody is left to drain the queue.
+          if (selectionThreadsLeft.load(std::memory_order_acquire) == 0) {
+            backpropagate(batch);
+            break;
+          }
+          std::this_thread::yield();
+        }
+      }
+
+      playouts.fetch_add(simulated, std::memory_order_relaxed);
+      simulationStalls.fetch_add(stalls, std::memory_order_relaxed);
+    }));
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // Release the virtual losses of everything still in flight.
+  Batch batch;
+  while (toSimulate.tryPop(&batch)) {
+    for (int i = 0; i < batch.size; i++) {
+      batch.leaves[i]->removeVirtualLoss();
+    }
+  }
+  drainResults();
+
+  PipelineStats stats;
+  stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  stats.leavesSelected = leavesSelected.load();
+  stats.playouts = playouts.load();
+  stats.leavesBackpropagated = leavesBackpropagated.load();
+  stats.selectionStalls = selectionStalls.load();
+  stats.simulationStalls = simulationStalls.load();
+  return stats;
+}
+
+template PipelineStats BasicAI<BasicBoard<6, 7, 4>>::thinkPipelined(
+    State *, Clock::duration, const PipelineOptions &);
+template PipelineStats BasicAI<BasicBoard<7, 8, 4>>::thinkPipelined(
+    State *, Clock::duration, const PipelineOptions &);
+template PipelineStats BasicAI<BasicBoard<5, 4, 4>>::thinkPipelined(
+    State *, Clock::duration, const PipelineOptions &);
+template PipelineStats BasicAI<BasicBoard<8, 9, 5>>::thinkPipelined(
+    State *, Clock::duration, const PipelineOptions &);
+
+template PipelineStats BasicAI<Board, UniformPolicy>::thinkPipelined(
+    State *, Clock::duration, const PipelineOptions &);
+template PipelineStats BasicAI<Board, ThreatPolicy>::thinkPipelined(
+    State *, Clock::duration, const PipelineOptions &);
+template PipelineStats BasicAI<Board, UniformUcbPolicy>::thinkPipelined(
+    State *, Clock::duration, const PipelineOptions &);
+template PipelineStats BasicAI<Board, SafeUcbPolicy>::thinkPipelined(
+    State *, Clock::duration, const PipelineOptions &);
+template PipelineStats BasicAI<Board, ThreatUcbPolicy>::thinkPipelined(
+    State *, Clock::duration, const PipelineOptions &);
+
+} // namespace ais::conn4
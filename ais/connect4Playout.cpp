@@ -0,0 +1,222 @@
+#include "ais/connect4Playout.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace ais::conn4 {
+namespace {
+
+using Player = BoardBase::Player;
+
+// Every lane of a 64-bit board in one GCC vector. Its arithmetic compiles to
+// the SIMD instructions of the kernel it's inlined into: one 512-bit op per
+// step with AVX-512, two 256-bit ones with AVX2 and four 128-bit SSE2 ones in
+// the portable kernel.
+typedef uint64_t LaneVec
+    __attribute__((vector_size(kPlayoutLanes * sizeof(uint64_t))));
+
+// The legal-move, winning-move and threat masks of every lane.
+template <typename BoardT>
+[[gnu::always_inline]] inline void
+laneMasks(const typename BoardT::Bits *cur, const typename BoardT::Bits *opp,
+          const typename BoardT::Bits *mask, typename BoardT::Bits *possible,
+          typename BoardT::Bits *myWin, typename BoardT::Bits *oppWin) {
+  using Bits = typename BoardT::Bits;
+  if constexpr (sizeof(Bits) == sizeof(uint64_t)) {
+    LaneVec vcur, vopp, vmask;
+    memcpy(&vcur, cur, sizeof(vcur));
+    memcpy(&vopp, opp, sizeof(vopp));
+    memcpy(&vmask, mask, sizeof(vmask));
+    LaneVec vpossible = (vmask + BoardT::kBottomMask) & BoardT::kBoardMask;
+    LaneVec vmyWin{};
+    BoardT::addWinningCells(vcur, &vmyWin);
+    vmyWin &= vpossible;
+    LaneVec voppWin{};
+    BoardT::addWinningCells(vopp, &voppWin);
+    voppWin &= BoardT::kBoardMask & ~vmask;
+    memcpy(possible, &vpossible, sizeof(vpossible));
+    memcpy(myWin, &vmyWin, sizeof(vmyWin));
+    memcpy(oppWin, &voppWin, sizeof(voppWin));
+  } else {
+    // No vector type holds 128-bit lanes.
+    for (int lane = 0; lane < kPlayoutLanes; lane++) {
+      possible[lane] = (mask[lane] + BoardT::kBottomMask) & BoardT::kBoardMask;
+      myWin[lane] = BoardT::winningCells(cur[lane]) & possible[lane];
+      oppWin[lane] =
+          BoardT::winningCells(opp[lane]) & BoardT::kBoardMask & ~mask[lane];
+    }
+  }
+}
+
+template <typename BoardT, typename PlayoutT>
+[[gnu::always_inline]] inline void
+playBatch(const BoardT &board, Player playerToMove, uint64_t seed,
+          Player *winners) {
+  using Bits = typename BoardT::Bits;
+
+  Bits cur[kPlayoutLanes];
+  Bits opp[kPlayoutLanes];
+  Bits mask[kPlayoutLanes];
+  uint64_t rng[kPlayoutLanes];
+  bool done[kPlayoutLanes];
+  for (int lane = 0; lane < kPlayoutLanes; lane++) {
+    cur[lane] = board.board_[BoardT::bIdx(playerToMove)];
+    opp[lane] = board.board_[BoardT::bIdx(BoardT::other(playerToMove))];
+    mask[lane] = cur[lane] | opp[lane];
+    rng[lane] = (seed + lane) * 0x9e3779b97f4a7c15ULL | 1;
+    done[lane] = false;
+  }
+
+  // Every lane started with the same player and moves once per step, so the
+  // player to move is shared.
+  Player mover = playerToMove;
+  int numDone = 0;
+  while (numDone < kPlayoutLanes) {
+    Bits possible[kPlayoutLanes];
+    Bits myWin[kPlayoutLanes];
+    Bits oppWin[kPlayoutLanes];
+    laneMasks<BoardT>(cur, opp, mask, possible, myWin, oppWin);
+
+    // Picking the move depends on each lane's masks, so it's one lane at a
+    // time.
+    for (int lane = 0; lane < kPlayoutLanes; lane++) {
+      if (done[lane]) {
+        continue;
+      }
+
+      Player winner;
+      if (possible[lane] == 0) {
+        winner = Player::Draw;
+      } else {
+        Bits move = PlayoutT::template pickMove<BoardT>(
+            cur[lane], opp[lane], possible[lane], myWin[lane], oppWin[lane],
+            &rng[lane]);
+        if (move == 0) {
+          winner = BoardT::other(mover);
+        } else if (move & myWin[lane]) {
+          winner = mover;
+        } else {
+          Bits next = cur[lane] | move;
+          cur[lane] = opp[lane];
+          opp[lane] = next;
+          mask[lane] |= move;
+          continue;
+        }
+      }
+
+      winners[lane] = winner;
+      done[lane] = true;
+      numDone++;
+    }
+    mover = BoardT::other(mover);
+  }
+}
+
+template <typename BoardT, typename PlayoutT>
+void playBatchScalar(const BoardT &board, Player playerToMove, uint64_t seed,
+                     Player *winners) {
+  playBatch<BoardT, PlayoutT>(board, playerToMove, seed, winners);
+}
+
+template <typename BoardT, typename PlayoutT>
+__attribute__((target("avx2,bmi,bmi2,popcnt"))) void
+playBatchAvx2(const BoardT &board, Player playerToMove, uint64_t seed,
+              Player *winners) {
+  playBatch<BoardT, PlayoutT>(board, playerToMove, seed, winners);
+}
+
+template <typename BoardT, typename PlayoutT>
+__attribute__((target("avx512f,avx512vl,avx512bw,bmi,bmi2,popcnt"))) void
+playBatchAvx512(const BoardT &board, Player playerToMove, uint64_t seed,
+                Player *winners) {
+  playBatch<BoardT, PlayoutT>(board, playerToMove, seed, winners);
+}
+
+bool hasAvx512() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") &&
+         __builtin_cpu_supports("avx512vl") &&
+         __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("bmi2");
+}
+
+bool hasAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
+}
+
+template <typename BoardT>
+using BatchKernel = void (*)(const BoardT &, Player, uint64_t, Player *);
+
+template <typename BoardT, typename PlayoutT>
+BatchKernel<BoardT> pickKernel() {
+  if constexpr (sizeof(typename BoardT::Bits) == sizeof(uint64_t)) {
+    if (hasAvx512()) {
+      return playBatchAvx512<BoardT, PlayoutT>;
+    }
+    if (hasAvx2()) {
+      return playBatchAvx2<BoardT, PlayoutT>;
+    }
+  }
+  return playBatchScalar<BoardT, PlayoutT>;
+}
+
+} // namespace
+
+template <typename BoardT, typename PlayoutT>
+void batchMonteCarloTrials(const BoardT &board, Player playerToMove,
+                           int numTrials, Player *winners) {
+  static_assert(PlayoutPolicy<PlayoutT, BoardT>);
+
+  auto winner = board.winner();
+  if (winner != Player::None) {
+    std::fill(winners, winners + numTrials, winner);
+    return;
+  }
+
+  static const BatchKernel<BoardT> kernel = pickKernel<BoardT, PlayoutT>();
+  thread_local std::random_device rd;
+  thread_local std::mt19937_64 gen(rd());
+
+  Player batch[kPlayoutLanes];
+  for (int i = 0; i < numTrials; i += kPlayoutLanes) {
+    kernel(board, playerToMove, gen(), batch);
+    int n = std::min(kPlayoutLanes, numTrials - i);
+    std::copy(batch, batch + n, winners + i);
+  }
+}
+
+// The same choice as pickKernel.
+template <typename BoardT> const char *batchPlayoutIsa() {
+  if constexpr (sizeof(typename BoardT::Bits) == sizeof(uint64_t)) {
+    if (hasAvx512()) {
+      return "avx512";
+    }
+    if (hasAvx2()) {
+      return "avx2";
+    }
+  }
+  return "scalar";
+}
+
+template void batchMonteCarloTrials<BasicBoard<6, 7, 4>, SafePlayout>(
+    const BasicBoard<6, 7, 4> &, Player, int, Player *);
+template void batchMonteCarloTrials<BasicBoard<7, 8, 4>, SafePlayout>(
+    const BasicBoard<7, 8, 4> &, Player, int, Player *);
+template void batchMonteCarloTrials<BasicBoard<5, 4, 4>, SafePlayout>(
+    const BasicBoard<5, 4, 4> &, Player, int, Player *);
+template void batchMonteCarloTrials<BasicBoard<8, 9, 5>, SafePlayout>(
+    const BasicBoard<8, 9, 5> &, Player, int, Player *);
+
+template void batchMonteCarloTrials<Board, UniformPlayout>(const Board &,
+                                                           Player, int,
+                                                           Player *);
+template void batchMonteCarloTrials<Board, ThreatPlayout>(const Board &, Player,
+                                                          int, Player *);
+
+template const char *batchPlayoutIsa<BasicBoard<6, 7, 4>>();
+template const char *batchPlayoutIsa<BasicBoard<7, 8, 4>>();
+template const char *batchPlayoutIsa<BasicBoard<5, 4, 4>>();
+template const char *batchPlayoutIsa<BasicBoard<8, 9, 5>>();
+
+} // namespace ais::conn4
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ais/connect4AI.h"
+#include "ais/connect4Policy.h"
+
+namespace ais::conn4 {
+
+// Plays `numTrials` random games from `board` with PlayoutT (see
+// connect4Policy.h) and writes each winner to `winners`. Draws are reported as
+// Player::Draw.
+//
+// Games are advanced kPlayoutLanes at a time in lockstep. Each step computes
+// the legal-move, winning-move and threat masks of every lane at once with
+// SIMD instructions, then picks each lane's move on its own. The widest
+// kernel the CPU supports is picked at runtime; boards that need 128 bits
+// always use the portable kernel, with scalar masks.
+static constexpr int kPlayoutLanes = 8;
+
+template <typename BoardT, typename PlayoutT = SafePlayout>
+void batchMonteCarloTrials(const BoardT &board, BoardBase::Player playerToMove,
+                           int numTrials, BoardBase::Player *winners);
+
+// "avx512", "avx2" or "scalar": the kernel batchMonteCarloTrials uses for
+// BoardT on this CPU.
+template <typename BoardT> const char *batchPlayoutIsa();
+
+extern template void batchMonteCarloTrials<BasicBoard<6, 7, 4>, SafePlayout>(
+    const BasicBoard<6, 7, 4> &, BoardBase::Player, int, BoardBase::Player *);
+extern template void batchMonteCarloTrials<BasicBoard<7, 8, 4>, SafePlayout>(
+    const BasicBoard<7, 8, 4> &, BoardBase::Player, int, BoardBase::Player *);
+extern template void batchMonteCarloTrials<BasicBoard<5, 4, 4>, SafePlayout>(
+    const BasicBoard<5, 4, 4> &, BoardBase::Player, int, BoardBase::Player *);
+extern template void batchMonteCarloTrials<BasicBoard<8, 9, 5>, SafePlayout>(
+    const BasicBoard<8, 9, 5> &, BoardBase::Player, int, BoardBase::Player *);
+
+extern template void batchMonteCarloTrials<Board, UniformPlayout>(
+    const Board &, BoardBase::Player, int, BoardBase::Player *);
+extern template void batchMonteCarloTrials<Board, ThreatPlayout>(
+    const Board &, BoardBase::Player, int, BoardBase::Player *);
+
+extern template const char *batchPlayoutIsa<BasicBoard<6, 7, 4>>();
+extern template const char *batchPlayoutIsa<BasicBoard<7, 8, 4>>();
+extern template const char *batchPlayoutIsa<BasicBoard<5, 4, 4>>();
+extern template const char *batchPlayoutIsa<BasicBoard<8, 9, 5>>();
+
+} // namespace ais::conn4
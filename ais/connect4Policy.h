@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#include "ais/connect4AI.h"
+
+namespace ais::conn4 {
+
+// The search is parameterised on a SearchPolicy, a pair of a playout policy
+// and a selection policy. They are template parameters rather than virtual
+// interfaces so that every combination compiles to its own fully inlined
+// playout and descent loops.
+//
+// A playout policy picks the moves of the random games that estimate win
+// probabilities:
+//
+//   template <typename BoardT>
+//   static Bits pickMove(Bits cur, Bits opp, Bits possible, Bits myWin,
+//                        Bits oppWin, uint64_t *rng);
+//
+// `cur` and `opp` are the stones of the player to move and of the opponent,
+// `possible` the (nonempty) playable cells, `myWin` the playable cells that
+// win on the spot and `oppWin` every empty cell that would win for the
+// opponent. It returns one cell of `possible`, or 0 to concede when every
+// move loses. It runs in every lane of a batched playout (see
+// connect4Playout.h), so it should stick to bitboard arithmetic.
+template <typename P, typename BoardT>
+concept PlayoutPolicy = requires(typename BoardT::Bits b, uint64_t *rng) {
+  {
+    P::template pickMove<BoardT>(b, b, b, b, b, rng)
+  } -> std::same_as<typename BoardT::Bits>;
+};
+
+// A selection policy picks the child that the search descends into from an
+// expanded, unsolved state:
+//
+//   template <typename StateT>
+//   static int pickChild(const StateT &state, std::mt19937 *gen,
+//                        int playoutsPerLeaf);
+//
+// It returns the child's column, or -1 if there's nothing to descend into.
+// Each virtual loss on a child stands for playoutsPerLeaf playouts that are
+// scheduled but not yet recorded (see BasicAI::thinkPipelined); thinkHard
+// passes 0.
+template <typename P, typename StateT>
+concept SelectionPolicy = requires(const StateT &state, std::mt19937 *gen) {
+  { P::pickChild(state, gen, 0) } -> std::same_as<int>;
+};
+
+template <typename PlayoutT, typename SelectionT> struct SearchPolicy {
+  using Playout = PlayoutT;
+  using Selection = SelectionT;
+};
+
+[[gnu::always_inline]] inline uint64_t nextRandom(uint64_t *state) {
+  // xorshift64*
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545f4914f6cdd1dULL;
+}
+
+// One of the set bits of `cells`, which must be nonzero, chosen uniformly.
+template <typename BoardT>
+[[gnu::always_inline]] inline typename BoardT::Bits
+randomCell(typename BoardT::Bits cells, uint64_t *rng) {
+  uint64_t numCells = BoardT::popcount(cells);
+  uint64_t pick = ((nextRandom(rng) >> 32) * numCells) >> 32;
+  for (uint64_t i = 0; i < pick; i++) {
+    cells &= cells - 1;
+  }
+  return cells & (~cells + 1);
+}
+
+// Moves after which the opponent has no immediate win.
+template <typename BoardT>
+[[gnu::always_inline]] inline typename BoardT::Bits
+safeMoves(typename BoardT::Bits possible, typename BoardT::Bits oppWin) {
+  auto forced = possible & oppWin;
+  if (forced) {
+    if (forced & (forced - 1)) {
+      return 0;
+    }
+    possible = forced;
+  }
+  // Don't play directly below a cell the opponent wins with.
+  return possible & ~(oppWin >> 1);
+}
+
+// Any legal move, even one that misses a win or hands one to the opponent.
+// The cheapest policy and the noisiest estimate.
+struct UniformPlayout {
+  template <typename BoardT>
+  [[gnu::always_inline]] static inline typename BoardT::Bits
+  pickMove(typename BoardT::Bits /*cur*/, typename BoardT::Bits /*opp*/,
+           typename BoardT::Bits possible, typename BoardT::Bits /*myWin*/,
+           typename BoardT::Bits /*oppWin*/, uint64_t *rng) {
+    return randomCell<BoardT>(possible, rng);
+  }
+};
+
+// Wins when it can, and otherwise plays a random move that doesn't give the
+// opponent an immediate win.
+struct SafePlayout {
+  template <typename BoardT>
+  [[gnu::always_inline]] static inline typename BoardT::Bits
+  pickMove(typename BoardT::Bits /*cur*/, typename BoardT::Bits /*opp*/,
+           typename BoardT::Bits possible, typename BoardT::Bits myWin,
+           typename BoardT::Bits oppWin, uint64_t *rng) {
+    if (myWin) {
+      return myWin & (~myWin + 1);
+    }
+    auto safe = safeMoves<BoardT>(possible, oppWin);
+    return safe ? randomCell<BoardT>(safe, rng) : 0;
+  }
+};
+
+// SafePlayout, except that among the safe moves it plays one that makes a new
+// threat (an empty cell that would complete a line) whenever there is one.
+// Each candidate costs a winningCells, so it plays fewer, stronger games.
+struct ThreatPlayout {
+  template <typename BoardT>
+  [[gnu::always_inline]] static inline typename BoardT::Bits
+  pickMove(typename BoardT::Bits cur, typename BoardT::Bits opp,
+           typename BoardT::Bits possible, typename BoardT::Bits myWin,
+           typename BoardT::Bits oppWin, uint64_t *rng) {
+    using Bits = typename BoardT::Bits;
+    if (myWin) {
+      return myWin & (~myWin + 1);
+    }
+    Bits safe = safeMoves<BoardT>(possible, oppWin);
+    if (!safe) {
+      return 0;
+    }
+
+    Bits empty = BoardT::kBoardMask & ~(cur | opp);
+    Bits threats = BoardT::winningCells(cur) & empty;
+    Bits threatening = 0;
+    for (Bits moves = safe; moves; moves &= moves - 1) {
+      Bits move = moves & (~moves + 1);
+      if (BoardT::winningCells(cur | move) & empty & ~move & ~threats) {
+        threatening |= move;
+      }
+    }
+    return randomCell<BoardT>(threatening ? threatening : safe, rng);
+  }
+};
+
+// Picks a child at random in proportion to its win probability for the
+// player to move, discounted by the playouts already scheduled below it.
+struct RouletteSelection {
+  template <typename StateT>
+  static int pickChild(const StateT &state, std::mt19937 *gen,
+                       int playoutsPerLeaf) {
+    constexpr int kCols = StateT::BoardType::kCols;
+    std::array<double, kCols> winningProbs;
+    double totalProb = 0.0;
+    int firstChild = -1;
+    for (int col = 0; col < kCols; col++) {
+      auto *child = state.getChild(col);
+      if (child == nullptr) {
+        winningProbs[col] = 0.0;
+        continue;
+      }
+      if (firstChild < 0) {
+        firstChild = col;
+      }
+      double p = child->winProb().prob(state.playerToMove());
+      double numTrials = child->winProb().numTrials();
+      double pending = child->virtualLoss() * playoutsPerLeaf;
+      if (numTrials > 0.0) {
+        p *= numTrials / (numTrials + pending);
+      }
+      winningProbs[col] = p;
+      totalProb += p;
+    }
+
+    if (totalProb == 0.0) {
+      return firstChild;
+    }
+    std::uniform_real_distribution<> selectionDist(0, totalProb);
+    double selector = selectionDist(*gen);
+    double cumulative = 0.0;
+    int lastCol = firstChild;
+    for (int col = 0; col < kCols; col++) {
+      if (winningProbs[col] == 0.0) {
+        continue;
+      }
+      cumulative += winningProbs[col];
+      lastCol = col;
+      if (cumulative >= selector) {
+        return col;
+      }
+    }
+    // Rounding left the selector just past the end.
+    return lastCol;
+  }
+};
+
+// UCB1: the child with the best win probability plus an exploration bonus
+// that shrinks as the child gets trials. Scheduled playouts count as losses.
+// Deterministic, so threads that share a tree spread out only through the
+// trial counts they update.
+struct UcbSelection {
+  static constexpr double kExploration = 1.0;
+
+  template <typename StateT>
+  static int pickChild(const StateT &state, std::mt19937 * /*gen*/,
+                       int playoutsPerLeaf) {
+    constexpr int kCols = StateT::BoardType::kCols;
+    using Player = typename StateT::Player;
+    auto playerToMove = state.playerToMove();
+
+    double totalTrials = 0.0;
+    int firstChild = -1;
+    for (int col = 0; col < kCols; col++) {
+      auto *child = state.getChild(col);
+      if (child == nullptr) {
+        continue;
+      }
+      if (firstChild < 0) {
+        firstChild = col;
+      }
+      if (child->winProb().solvedWinner() == Player::None) {
+        totalTrials += child->winProb().numTrials() +
+                       child->virtualLoss() * playoutsPerLeaf;
+      }
+    }
+    double logTotal = std::log(std::max(totalTrials, 1.0));
+
+    int best = firstChild;
+    double bestScore = -std::numeric_limits<double>::infinity();
+    for (int col = 0; col < kCols; col++) {
+      auto *child = state.getChild(col);
+      if (child == nullptr) {
+        continue;
+      }
+      auto winner = child->winProb().solvedWinner();
+      if (winner == playerToMove) {
+        return col;
+      } else if (winner != Player::None) {
+        continue;
+      }
+      double numTrials = child->winProb().numTrials();
+      double visits =
+          std::max(numTrials + child->virtualLoss() * playoutsPerLeaf, 1.0);
+      double score = child->winProb().prob(playerToMove) * numTrials / visits +
+                     kExploration * std::sqrt(logTotal / visits);
+      if (score > bestScore) {
+        bestScore = score;
+        best = col;
+      }
+    }
+    return best;
+  }
+};
+
+// The combinations instantiated for the default Board, for benchmarks and
+// experiments. Every geometry gets DefaultPolicy.
+using UniformPolicy = SearchPolicy<UniformPlayout, RouletteSelection>;
+using ThreatPolicy = SearchPolicy<ThreatPlayout, RouletteSelection>;
+using UniformUcbPolicy = SearchPolicy<UniformPlayout, UcbSelection>;
+using SafeUcbPolicy = SearchPolicy<SafePlayout, UcbSelection>;
+using ThreatUcbPolicy = SearchPolicy<ThreatPlayout, UcbSelection>;
+
+extern template class BasicState<Board, UniformPolicy>;
+extern template class BasicState<Board, ThreatPolicy>;
+extern template class BasicState<Board, UniformUcbPolicy>;
+extern template class BasicState<Board, SafeUcbPolicy>;
+extern template class BasicState<Board, ThreatUcbPolicy>;
+
+extern template class BasicAI<Board, UniformPolicy>;
+extern template class BasicAI<Board, ThreatPolicy>;
+extern template class BasicAI<Board, UniformUcbPolicy>;
+extern template class BasicAI<Board, SafeUcbPolicy>;
+extern template class BasicAI<Board, ThreatUcbPolicy>;
+
+} // namespace ais::conn4
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace ais::conn4 {
+
+// Midgame positions from random games, as the Board::board_ bitboards of a 6x7
+// Board. Each is a forced win for the player to move with no immediate win,
+// so a short search can get them wrong but DfpnSolver can say which moves
+// are right.
+constexpr std::array<std::array<uint64_t, 2>, 4> kDecidedPositions{{
+    {0x40013808003, 0x24634080},
+    {0x301060c002, 0x4820800185},
+    {0x50181000c001, 0x2c0000200186},
+    {0x186800004003, 0x241030000184},
+}};
+
+// Like kDecidedPositions, but with only one or two winning moves out of six
+// or seven.
+constexpr std::array<std::array<uint64_t, 2>, 8> kNarrowWinPositions{{
+    {0x100280c103, 0x805610080},
+    {0xc1030208002, 0x800404185},
+    {0xc0050000581, 0x19a0204200},
+    {0x540020c24080, 0x280810218100},
+    {0x87010204000, 0x48800008181},
+    {0x280000c302, 0x101001008d},
+    {0xc5801a10000, 0x10201040c081},
+    {0x8080002c480, 0x40010010b01},
+}};
+
+} // namespace ais::conn4
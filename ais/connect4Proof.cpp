@@ -0,0 +1,368 @@
+#include "ais/connect4Proof.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <thread>
+#include <unordered_set>
+
+#include "ais/connect4Policy.h"
+
+namespace ais::conn4 {
+namespace {
+
+// Columns from the centre out, which is where most wins are.
+template <typename BoardT> constexpr std::array<int, BoardT::kCols> kColOrder =
+    [] {
+      std::array<int, BoardT::kCols> order{};
+      for (int i = 0; i < BoardT::kCols; i++) {
+        order[i] =
+            BoardT::kCols / 2 + (i % 2 == 0 ? i / 2 : -(i + 1) / 2);
+      }
+      return order;
+    }();
+
+template <typename Bits> inline uint64_t fold(Bits b) {
+  if constexpr (sizeof(Bits) == sizeof(uint64_t)) {
+    return b;
+  } else {
+    return static_cast<uint64_t>(b) ^ static_cast<uint64_t>(b >> 64);
+  }
+}
+
+} // namespace
+
+template <typename BoardT>
+DfpnSolver<BoardT>::DfpnSolver(int tableBits)
+    : tableBits_(tableBits), table_(size_t{1} << tableBits) {}
+
+template <typename BoardT>
+typename DfpnSolver<BoardT>::Outcome
+DfpnSolver<BoardT>::expand(Bits cur, Bits opp, int *cols, Bits *moves,
+                           int *numMoves) {
+  Bits mask = cur | opp;
+  Bits possible = (mask + BoardT::kBottomMask) & BoardT::kBoardMask;
+  if (BoardT::winningCells(cur) & possible) {
+    return Outcome::kWin;
+  }
+  if (!possible) {
+    return Outcome::kDraw;
+  }
+
+  Bits oppWin = BoardT::winningCells(opp) & BoardT::kBoardMask & ~mask;
+  possible = safeMoves<BoardT>(possible, oppWin);
+  if (!possible) {
+    return Outcome::kLoss;
+  }
+
+  *numMoves = 0;
+  for (int col : kColOrder<BoardT>) {
+    Bits colMask = Bits{BoardT::kColMask} << (col * BoardT::kColStride);
+    Bits move = possible & colMask;
+    if (move) {
+      cols[*numMoves] = col;
+      moves[*numMoves] = move;
+      (*numMoves)++;
+    }
+  }
+  return Outcome::kOpen;
+}
+
+template <typename BoardT>
+size_t DfpnSolver<BoardT>::index(Bits cur, Bits opp,
+                                 bool attackerToMove) const {
+  uint64_t h = fold(cur) * 0x9e3779b97f4a7c15ULL;
+  h ^= fold(opp) * 0xc2b2ae3d27d4eb4fULL;
+  h ^= attackerToMove;
+  h *= 0xff51afd7ed558ccdULL;
+  return h >> (64 - tableBits_);
+}
+
+template <typename BoardT>
+void DfpnSolver<BoardT>::lookup(Bits cur, Bits opp, bool attackerToMove,
+                                uint32_t *pn, uint32_t *dn) const {
+  const auto &entry = table_[index(cur, opp, attackerToMove)];
+  if (entry.used && entry.cur == cur && entry.opp == opp &&
+      entry.attackerToMove == attackerToMove) {
+    *pn = entry.pn;
+    *dn = entry.dn;
+  } else {
+    *pn = 1;
+    *dn = 1;
+  }
+}
+
+template <typename BoardT>
+void DfpnSolver<BoardT>::store(Bits cur, Bits opp, bool attackerToMove,
+                               uint32_t pn, uint32_t dn) {
+  // Always replace: the latest result is the one the search is most likely to
+  // come back to.
+  table_[index(cur, opp, attackerToMove)] = Entry{.cur = cur,
+                                                  .opp = opp,
+                                                  .pn = pn,
+                                                  .dn = dn,
+                                                  .attackerToMove =
+                                                      attackerToMove,
+                                                  .used = true};
+}
+
+template <typename BoardT>
+void DfpnSolver<BoardT>::mid(Bits cur, Bits opp, bool attackerToMove,
+                             uint32_t thpn, uint32_t thdn, uint32_t *pn,
+                             uint32_t *dn) {
+  nodes_++;
+  if (nodes_ >= maxNodes_ ||
+      (nodes_ % 1024 == 0 && Clock::now() >= deadline_)) {
+    aborted_ = true;
+  }
+
+  int cols[BoardT::kCols];
+  Bits moves[BoardT::kCols];
+  int numMoves = 0;
+  auto outcome = expand(cur, opp, cols, moves, &numMoves);
+  if (outcome != Outcome::kOpen) {
+    bool attackerWins = (outcome == Outcome::kWin) == attackerToMove &&
+                        outcome != Outcome::kDraw;
+    *pn = attackerWins ? 0 : kInfinity;
+    *dn = attackerWins ? kInfinity : 0;
+    store(cur, opp, attackerToMove, *pn, *dn);
+    return;
+  }
+
+  // At an OR node the proof number is the smallest of the children's and the
+  // disproof number the sum; at an AND node it's the other way around. `least`
+  // and `sum` are named for the OR case and swapped for AND.
+  while (true) {
+    uint32_t least = kInfinity;
+    uint32_t secondLeast = kInfinity;
+    uint64_t sum = 0;
+    int best = 0;
+    uint32_t bestSum = 0;
+    for (int i = 0; i < numMoves; i++) {
+      uint32_t childPn, childDn;
+      lookup(opp, cur | moves[i], !attackerToMove, &childPn, &childDn);
+      uint32_t childLeast = attackerToMove ? childPn : childDn;
+      uint32_t childSum = attackerToMove ? childDn : childPn;
+      sum = std::min<uint64_t>(sum + childSum, kInfinity);
+      if (childLeast < least) {
+        secondLeast = least;
+        least = childLeast;
+        best = i;
+        bestSum = childSum;
+      } else if (childLeast < secondLeast) {
+        secondLeast = childLeast;
+      }
+    }
+
+    *pn = attackerToMove ? least : sum;
+    *dn = attackerToMove ? sum : least;
+    if (*pn >= thpn || *dn >= thdn || aborted_) {
+      break;
+    }
+
+    uint32_t thLeast = attackerToMove ? thpn : thdn;
+    uint32_t thSum = attackerToMove ? thdn : thpn;
+    uint32_t childThLeast = std::min(thLeast, secondLeast + 1);
+    uint32_t childThSum =
+        std::min<uint64_t>(uint64_t{thSum} - sum + bestSum, kInfinity);
+    uint32_t childPn, childDn;
+    mid(opp, cur | moves[best], !attackerToMove,
+        attackerToMove ? childThLeast : childThSum,
+        attackerToMove ? childThSum : childThLeast, &childPn, &childDn);
+  }
+
+  store(cur, opp, attackerToMove, *pn, *dn);
+}
+
+template <typename BoardT>
+typename DfpnSolver<BoardT>::Result
+DfpnSolver<BoardT>::solve(const BoardT &board, Player playerToMove,
+                          Player attacker, uint64_t maxNodes,
+                          Clock::time_point deadline, int *winningCol) {
+  nodes_ = 0;
+  maxNodes_ = maxNodes;
+  deadline_ = deadline;
+  aborted_ = false;
+
+  Bits cur = board.board_[BoardT::bIdx(playerToMove)];
+  Bits opp = board.board_[BoardT::bIdx(BoardT::other(playerToMove))];
+  bool attackerToMove = attacker == playerToMove;
+  uint32_t pn, dn;
+  mid(cur, opp, attackerToMove, kInfinity, kInfinity, &pn, &dn);
+  totalNodes_ += nodes_;
+
+  if (pn != 0) {
+    return dn == 0 ? Result::kDisproved : Result::kUnknown;
+  }
+
+  if (winningCol && attackerToMove) {
+    *winningCol = -1;
+    int cols[BoardT::kCols];
+    Bits moves[BoardT::kCols];
+    int numMoves = 0;
+    if (expand(cur, opp, cols, moves, &numMoves) == Outcome::kWin) {
+      Bits mask = cur | opp;
+      Bits cells = BoardT::winningCells(cur) &
+                   ((mask + BoardT::kBottomMask) & BoardT::kBoardMask);
+      for (int col = 0; col < BoardT::kCols; col++) {
+        if (cells & (Bits{BoardT::kColMask} << (col * BoardT::kColStride))) {
+          *winningCol = col;
+          break;
+        }
+      }
+    } else {
+      for (int i = 0; i < numMoves; i++) {
+        uint32_t childPn, childDn;
+        lookup(opp, cur | moves[i], false, &childPn, &childDn);
+        if (childPn == 0) {
+          *winningCol = cols[i];
+          break;
+        }
+      }
+    }
+  }
+  return Result::kProved;
+}
+
+void ProofSearchStats::print() const {
+  printf("proof search: %llu df-pn nodes (%.0f nodes/s), %llu attempts, "
+         "%llu proofs\n",
+         static_cast<unsigned long long>(nodes), nodes / seconds,
+         static_cast<unsigned long long>(attempts),
+         static_cast<unsigned long long>(proofs));
+}
+
+template <typename BoardT, typename PolicyT>
+/*static*/
+ProofSearchStats
+BasicAI<BoardT, PolicyT>::proveHard(State *root,
+                                    Clock::duration durationPerMove,
+                                    const ProofSearchOptions &options) {
+  using Solver = DfpnSolver<BoardT>;
+  constexpr uint64_t kMaxBudget = uint64_t{1} << 40;
+
+  auto start = Clock::now();
+  auto deadline = start + durationPerMove;
+  auto isSolved = [](const State *state) {
+    return state->winProb().solvedWinner() != Player::None;
+  };
+
+  Solver solver(options.tableBits);
+  ProofSearchStats stats;
+  // Targets where neither side can force a win. The tree has no way to mark
+  // a draw, but there's no point in proving it again.
+  std::unordered_set<const State *> draws;
+
+  uint64_t budget = options.initialNodes;
+  while (Clock::now() < deadline && !isSolved(root)) {
+    // Shallow nodes first, and among those the ones thinkHard is spending the
+    // most playouts on. The root itself is left out: a root solved without a
+    // solved child wouldn't tell pickMove which move wins.
+    std::vector<State *> targets;
+    std::vector<State *> frontier{root};
+    for (int depth = 1; depth <= options.targetDepth; depth++) {
+      std::vector<State *> next;
+      for (auto *state : frontier) {
+        for (int col = 0; col < BoardT::kCols; col++) {
+          auto *child = state->getChild(col);
+          if (child && !isSolved(child)) {
+            next.push_back(child);
+          }
+        }
+      }
+      std::sort(next.begin(), next.end(), [](State *lhs, State *rhs) {
+        return lhs->winProb().numTrials() > rhs->winProb().numTrials();
+      });
+      targets.insert(targets.end(), next.begin(), next.end());
+      frontier = std::move(next);
+    }
+
+    bool attempted = false;
+    for (auto *target : targets) {
+      if (Clock::now() >= deadline || isSolved(root)) {
+        break;
+      }
+      if (isSolved(target) || draws.count(target)) {
+        continue;
+      }
+      attempted = true;
+
+      auto mover = target->playerToMove();
+      auto opponent = BoardT::other(mover);
+      stats.attempts++;
+      auto loss =
+          solver.solve(target->board(), mover, opponent, budget, deadline);
+      if (loss == Solver::Result::kProved) {
+        target->markSolvedState(opponent);
+        stats.proofs++;
+        continue;
+      }
+
+      stats.attempts++;
+      int winningCol = -1;
+      auto win = solver.solve(target->board(), mover, mover, budget, deadline,
+                              &winningCol);
+      if (win == Solver::Result::kProved) {
+        // Solved through the winning child, for the same reason the root is
+        // left out. If that child hasn't been expanded yet, the proof is
+        // found again once it is.
+        auto *child = winningCol >= 0 ? target->getChild(winningCol) : nullptr;
+        if (child) {
+          child->markSolvedState(mover);
+          stats.proofs++;
+        }
+      } else if (win == Solver::Result::kDisproved &&
+                 loss == Solver::Result::kDisproved) {
+        draws.insert(target);
+      }
+    }
+
+    if (attempted) {
+      budget = std::min(budget * 2, kMaxBudget);
+    } else {
+      // Nothing to prove until thinkHard expands more of the tree.
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  stats.seconds = elapsed.count();
+  stats.nodes = solver.nodes();
+  return stats;
+}
+
+template class DfpnSolver<BasicBoard<6, 7, 4>>;
+template class DfpnSolver<BasicBoard<7, 8, 4>>;
+template class DfpnSolver<BasicBoard<5, 4, 4>>;
+template class DfpnSolver<BasicBoard<8, 9, 5>>;
+
+template ProofSearchStats
+BasicAI<BasicBoard<6, 7, 4>>::proveHard(State *, Clock::duration,
+                                        const ProofSearchOptions &);
+template ProofSearchStats
+BasicAI<BasicBoard<7, 8, 4>>::proveHard(State *, Clock::duration,
+                                        const ProofSearchOptions &);
+template ProofSearchStats
+BasicAI<BasicBoard<5, 4, 4>>::proveHard(State *, Clock::duration,
+                                        const ProofSearchOptions &);
+template ProofSearchStats
+BasicAI<BasicBoard<8, 9, 5>>::proveHard(State *, Clock::duration,
+                                        const ProofSearchOptions &);
+
+template ProofSearchStats
+BasicAI<Board, UniformPolicy>::proveHard(State *, Clock::duration,
+                                         const ProofSearchOptions &);
+template ProofSearchStats
+BasicAI<Board, ThreatPolicy>::proveHard(State *, Clock::duration,
+                                        const ProofSearchOptions &);
+template ProofSearchStats
+BasicAI<Board, UniformUcbPolicy>::proveHard(State *, Clock::duration,
+                                            const ProofSearchOptions &);
+template ProofSearchStats
+BasicAI<Board, SafeUcbPolicy>::proveHard(State *, Clock::duration,
+                                         const ProofSearchOptions &);
+template ProofSearchStats
+BasicAI<Board, ThreatUcbPolicy>::proveHard(State *, Clock::duration,
+                                           const ProofSearchOptions &);
+
+} // namespace ais::conn4
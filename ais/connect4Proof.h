@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ais/connect4AI.h"
+
+namespace ais::conn4 {
+
+// Depth-first proof-number search (df-pn) for whether one player, the
+// attacker, can force a win. Nodes where the attacker moves are OR nodes, the
+// others AND nodes; a draw counts as a disproof. Positions are bitboard pairs
+// relative to the player to move, looked up in a fixed-size transposition
+// table that is kept across calls to solve, so later searches of nearby
+// positions reuse the earlier work.
+//
+// Like the playouts, the search never considers a move that hands the
+// opponent an immediate win, so forced sequences are found without
+// expanding the obvious refutations.
+template <typename BoardT> class DfpnSolver {
+public:
+  using Bits = typename BoardT::Bits;
+  using Player = BoardBase::Player;
+  using Clock = typename BasicAI<BoardT>::Clock;
+
+  enum class Result { kProved, kDisproved, kUnknown };
+
+  // The table has 1 << tableBits entries.
+  explicit DfpnSolver(int tableBits);
+
+  // Returns kUnknown if neither proof nor disproof was found within maxNodes
+  // expanded nodes or before the deadline. If the win is proved with the
+  // attacker to move, *winningCol is set to a column that wins, or to -1 if
+  // that has already been evicted from the table.
+  Result solve(const BoardT &board, Player playerToMove, Player attacker,
+               uint64_t maxNodes, Clock::time_point deadline,
+               int *winningCol = nullptr);
+
+  // Nodes expanded over every call to solve.
+  uint64_t nodes() const { return totalNodes_; }
+
+private:
+  static constexpr uint32_t kInfinity = 1U << 30;
+
+  enum class Outcome { kOpen, kWin, kLoss, kDraw };
+
+  struct Entry {
+    Bits cur{0};
+    Bits opp{0};
+    uint32_t pn{0};
+    uint32_t dn{0};
+    bool attackerToMove{false};
+    bool used{false};
+  };
+
+  // `cur` holds the stones of the player to move. For an open position, sets
+  // cols/moves to the moves worth searching, centre first.
+  static Outcome expand(Bits cur, Bits opp, int *cols, Bits *moves,
+                        int *numMoves);
+
+  size_t index(Bits cur, Bits opp, bool attackerToMove) const;
+  void lookup(Bits cur, Bits opp, bool attackerToMove, uint32_t *pn,
+              uint32_t *dn) const;
+  void store(Bits cur, Bits opp, bool attackerToMove, uint32_t pn,
+             uint32_t dn);
+
+  // Searches below the node until its proof number reaches thpn or its
+  // disproof number reaches thdn, and returns both in *pn and *dn.
+  void mid(Bits cur, Bits opp, bool attackerToMove, uint32_t thpn,
+           uint32_t thdn, uint32_t *pn, uint32_t *dn);
+
+  const int tableBits_;
+  std::vector<Entry> table_;
+  uint64_t totalNodes_{0};
+
+  // Per call to solve.
+  uint64_t nodes_{0};
+  uint64_t maxNodes_{0};
+  Clock::time_point deadline_;
+  bool aborted_{false};
+};
+
+extern template class DfpnSolver<BasicBoard<6, 7, 4>>;
+extern template class DfpnSolver<BasicBoard<7, 8, 4>>;
+extern template class DfpnSolver<BasicBoard<5, 4, 4>>;
+extern template class DfpnSolver<BasicBoard<8, 9, 5>>;
+
+} // namespace ais::conn4
@@ -0,0 +1,81 @@
+#include "ais/connect4SearchResult.h"
+
+namespace ais::conn4 {
+
+void SearchResult::merge(const SearchResult &other) {
+  for (int col = 0; col < Board::kCols; col++) {
+    auto &mine = columns[col];
+    const auto &theirs = other.columns[col];
+
+    uint64_t trials = mine.trials + theirs.trials;
+    if (trials > 0) {
+      mine.winProb =
+          (mine.winProb * mine.trials + theirs.winProb * theirs.trials) /
+          trials;
+    }
+    mine.trials = trials;
+
+    if (theirs.solvedWinner != Board::Player::None) {
+      mine.solvedWinner = theirs.solvedWinner;
+    }
+  }
+  playouts += other.playouts;
+}
+
+Board::Spot SearchResult::bestMove(const Board &board,
+                                   Board::Player playerToMove) const {
+  auto winningMove = board.getWinningMove(playerToMove);
+  if (winningMove != Board::kIllegalSpot) {
+    return winningMove;
+  }
+
+  auto legalMoves = board.legalMoves();
+  auto opponent = Board::other(playerToMove);
+
+  int bestCol = -1;
+  double bestProb = -1.0;
+  for (int col = 0; col < Board::kCols; col++) {
+    if (legalMoves.legalRowInCol[col] == Board::LegalMoves::kIllegal) {
+      continue;
+    }
+
+    const auto &column = columns[col];
+    double prob = column.winProb;
+    if (column.solvedWinner == playerToMove) {
+      prob = 2.0; // Above every unsolved column.
+    } else if (column.solvedWinner == opponent) {
+      prob = -0.5; // Only if every column is lost.
+    }
+
+    if (prob > bestProb) {
+      bestProb = prob;
+      bestCol = col;
+    }
+  }
+
+  if (bestCol < 0) {
+    return Board::kIllegalSpot;
+  }
+  return Board::Spot{.row = legalMoves.legalRowInCol[bestCol], .col = bestCol};
+}
+
+SearchResult collectSearchResult(const State &root) {
+  SearchResult result;
+  if (!root.hasChildren()) {
+    return result;
+  }
+
+  for (int col = 0; col < Board::kCols; col++) {
+    const auto *child = root.getChild(col);
+    if (!child) {
+      continue;
+    }
+    auto &column = result.columns[col];
+    column.trials = child->winProb().numTrials();
+    column.winProb = child->winProb().prob(root.playerToMove());
+    column.solvedWinner = child->winProb().solvedWinner();
+  }
+  return result;
+}
+
+} // namespace ais::conn4
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "ais/connect4AI.h"
+
+namespace ais::conn4 {
+
+// Statistics of the child reached by playing one column from the root.
+struct ColumnStats {
+  uint64_t trials{0};
+  // Probability that the player to move at the root wins after this move.
+  double winProb{0.0};
+  Board::Player solvedWinner{Board::Player::None};
+};
+
+// What a search found out about each move from its root, detached from the
+// tree so that it can be printed, sent between processes and merged.
+struct SearchResult {
+  std::array<ColumnStats, Board::kCols> columns{};
+  uint64_t playouts{0};
+
+  // Merges another search of the same position into this one. Trials add up,
+  // win probabilities are averaged weighted by trials, and a column solved by
+  // either search stays solved.
+  void merge(const SearchResult &other);
+
+  // Proven wins first, then the highest win probability among the columns
+  // that aren't proven losses.
+  Board::Spot bestMove(const Board &board, Board::Player playerToMove) const;
+};
+
+SearchResult collectSearchResult(const State &root);
+
+} // namespace ais::conn4
@@ -1,8 +1,17 @@
 #include "ais/connect4AI.h"
 
 #include <array>
+#include <cstring>
 #include <random>
-
+#include <set>
+#include <thread>
+#include <sstream>
+
+#include "ais/boundedQueue.h"
+#include "ais/connect4Playout.h"
+#include "ais/connect4Policy.h"
+#include "ais/connect4Positions.h"
+#include "ais/connect4Proof.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -216,6 +225,73 @@ TEST(Board, nextPlayer) {
   EXPECT_EQ(b.nextPlayer(), Board::Player::Two);
 }
 
+TEST(Board, geometryMasks) {
+  EXPECT_EQ(Board::popcount(Board::kBoardMask), Board::kRows * Board::kCols);
+  EXPECT_EQ(Board::popcount(Board::kBottomMask), Board::kCols);
+  static_assert(sizeof(Board::Bits) == sizeof(uint64_t));
+
+  using Connect5 = BasicBoard<8, 9, 5>;
+  EXPECT_EQ(Connect5::popcount(Connect5::kBoardMask), 8 * 9);
+  static_assert(sizeof(Connect5::Bits) == 2 * sizeof(uint64_t));
+}
+
+TEST(Board, smallBoard) {
+  using SmallBoard = BasicBoard<5, 4, 4>;
+
+  SmallBoard b;
+  for (int col = 0; col < 3; col++) {
+    b.move(Board::Spot{.row = 4, .col = col}, Board::Player::Two);
+  }
+  EXPECT_EQ(b.winner(), Board::Player::None);
+  b.move(Board::Spot{.row = 4, .col = 3}, Board::Player::Two);
+  EXPECT_EQ(b.winner(), Board::Player::Two);
+
+  // No four in a row anywhere.
+  SmallBoard draw("XXOO\n"
+                  "OOXX\n"
+                  "XXOO\n"
+                  "OOXX\n"
+                  "XXOO\n");
+  EXPECT_EQ(draw.winner(), Board::Player::Draw);
+  for (auto row : draw.legalMoves().legalRowInCol) {
+    EXPECT_EQ(row, SmallBoard::LegalMoves::kIllegal);
+  }
+}
+
+TEST(Board, connect5) {
+  using Connect5 = BasicBoard<8, 9, 5>;
+
+  for (auto player : std::to_array({Board::Player::One, Board::Player::Two})) {
+    // Rows and diagonals that straddle the 64-bit boundary.
+    Connect5 row;
+    Connect5 diag;
+    for (int i = 0; i < 4; i++) {
+      row.move(Board::Spot{.row = 7, .col = 4 + i}, player);
+      diag.move(Board::Spot{.row = 3 + i, .col = 4 + i}, player);
+    }
+    EXPECT_EQ(row.winner(), Board::Player::None);
+    EXPECT_EQ(diag.winner(), Board::Player::None);
+    row.move(Board::Spot{.row = 7, .col = 8}, player);
+    diag.move(Board::Spot{.row = 7, .col = 8}, player);
+    EXPECT_EQ(row.winner(), player);
+    EXPECT_EQ(diag.winner(), player);
+
+    Connect5 col;
+    for (int i = 0; i < 4; i++) {
+      col.move(Board::Spot{.row = 4 + i, .col = 8}, player);
+    }
+    EXPECT_EQ(col.winner(), Board::Player::None);
+    col.move(Board::Spot{.row = 3, .col = 8}, player);
+    EXPECT_EQ(col.winner(), player);
+  }
+
+  Connect5 b;
+  b.move(Board::Spot{.row = 0, .col = 8}, Board::Player::One);
+  EXPECT_EQ(b.nextPlayer(), Board::Player::Two);
+  EXPECT_EQ(b.legalMoves().legalRowInCol[8], 1);
+  EXPECT_TRUE(b.boardIsLegal());
+}
+
 TEST(State, monteCarlo) {
   State state(/*parent=*/nullptr, Board(), Board::Player::One);
 
@@ -227,4 +303,675 @@ TEST(State, monteCarlo) {
   EXPECT_LT(state.winProb().prob(Board::Player::One), 0.9545);
 }
 
+TEST(State, monteCarloConnect5) {
+  using Connect5 = BasicBoard<8, 9, 5>;
+  BasicState<Connect5> state(/*parent=*/nullptr, Connect5(),
+                             Board::Player::One);
+
+  for (int i = 0; i < 200; i++) {
+    auto winner = state.monteCarloTrial();
+    EXPECT_NE(winner, Board::Player::None);
+  }
+}
+
+TEST(State, lazyBootstrap) {
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  root.createChildren();
+  for (int col = 0; col < Board::kCols; col++) {
+    EXPECT_FALSE(root.getChild(col)->isBootstrapped());
+  }
+  EXPECT_NE(root.childToBootstrap(), nullptr);
+
+  AI::thinkHard(&root, std::chrono::milliseconds(200));
+  for (int col = 0; col < Board::kCols; col++) {
+    EXPECT_TRUE(root.getChild(col)->isBootstrapped());
+  }
+  EXPECT_EQ(root.childToBootstrap(), nullptr);
+}
+
+TEST(State, shardedTrials) {
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  uint32_t initialTrials = root.winProb().numTrials();
+
+  // Trials are batched in a per-thread shard before they become visible.
+  for (int i = 0; i < 15; i++) {
+    root.recordMonteCarloResult(Board::Player::Two);
+  }
+  EXPECT_EQ(root.winProb().numTrials(), initialTrials);
+  root.recordMonteCarloResult(Board::Player::Two);
+  EXPECT_EQ(root.winProb().numTrials(), initialTrials + 16);
+  EXPECT_GT(root.winProb().prob(Board::Player::Two), 0.9);
+
+  State::setShardedDepth(-1);
+  State unsharded(/*parent=*/nullptr, Board(), Board::Player::One);
+  State::setShardedDepth(State::kShardedDepth);
+  unsharded.recordMonteCarloResult(Board::Player::Two);
+  EXPECT_EQ(unsharded.winProb().numTrials(), initialTrials + 1);
+
+  // Expanding flushes the trials still pending in the shards.
+  for (int i = 0; i < 5; i++) {
+    root.recordMonteCarloResult(Board::Player::Two);
+  }
+  root.createChildren();
+  EXPECT_EQ(root.winProb().numTrials(), initialTrials + 21);
+  // Trials still in flight then are counted right away.
+  root.recordMonteCarloResult(Board::Player::Two);
+  EXPECT_EQ(root.winProb().numTrials(), initialTrials + 22);
+}
+
+TEST(State, shardedTrialsSurviveExpansion) {
+  constexpr int kThreads = 4;
+  constexpr int kTrialsPerThread = 1 << 18;
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  uint32_t initialTrials = root.winProb().numTrials();
+
+  std::atomic<int> recorded{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; i++) {
+    threads.push_back(std::thread([&]() {
+      for (int j = 0; j < kTrialsPerThread; j++) {
+        root.recordMonteCarloResult(Board::Player::Two);
+        recorded++;
+      }
+    }));
+  }
+  // Expand while the threads are halfway through.
+  while (recorded < kThreads * kTrialsPerThread / 2) {
+    std::this_thread::yield();
+  }
+  root.createChildren();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(root.winProb().numTrials(),
+            initialTrials + kThreads * kTrialsPerThread);
+}
+
+TEST(State, snapshotRoundTrip) {
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  root.createChildren();
+  root.getChild(3)->createChildren();
+
+  std::stringstream ss;
+  root.writeSnapshot(ss);
+  auto loaded = State::readSnapshot(ss);
+  ASSERT_NE(loaded, nullptr);
+
+  EXPECT_EQ(loaded->board().board_, root.board().board_);
+  EXPECT_EQ(loaded->winProb().numTrials(), root.winProb().numTrials());
+  EXPECT_TRUE(loaded->hasChildren());
+  for (int col = 0; col < Board::kCols; col++) {
+    auto *child = root.getChild(col);
+    auto *loadedChild = loaded->getChild(col);
+    ASSERT_NE(loadedChild, nullptr);
+    EXPECT_EQ(loadedChild->board().board_, child->board().board_);
+    EXPECT_EQ(loadedChild->winProb().numTrials(),
+              child->winProb().numTrials());
+    EXPECT_EQ(loadedChild->winProb().prob(Board::Player::One),
+              child->winProb().prob(Board::Player::One));
+    EXPECT_EQ(loadedChild->hasChildren(), col == 3);
+  }
+  EXPECT_NE(loaded->getChild(3)->getChild(3), nullptr);
+}
+
+TEST(State, snapshotPrune) {
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  root.createChildren();
+  root.getChild(3)->createChildren();
+
+  // Room for the root's children but not the grandchildren.
+  std::stringstream ss;
+  root.writeSnapshot(ss, /*maxNodes=*/1 + Board::kCols);
+  auto loaded = State::readSnapshot(ss);
+  ASSERT_NE(loaded, nullptr);
+  for (int col = 0; col < Board::kCols; col++) {
+    ASSERT_NE(loaded->getChild(col), nullptr);
+    EXPECT_FALSE(loaded->getChild(col)->hasChildren());
+  }
+}
+
+TEST(State, snapshotRejectsOtherGeometry) {
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  root.createChildren();
+
+  std::stringstream ss;
+  root.writeSnapshot(ss);
+  using WideState = BasicState<BasicBoard<7, 8, 4>>;
+  EXPECT_EQ(WideState::readSnapshot(ss), nullptr);
+
+  std::stringstream truncated(ss.str().substr(0, ss.str().size() / 2));
+  EXPECT_EQ(State::readSnapshot(truncated), nullptr);
+}
+
+TEST(State, snapshotRejectsCorruptValues) {
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  root.createChildren();
+
+  std::stringstream ss;
+  root.writeSnapshot(ss);
+  std::string snapshot = ss.str();
+  // The root's node comes first, followed by its children's.
+  size_t rootOffset = snapshot.size() - (1 + Board::kCols) *
+                                            (sizeof(uint64_t) + sizeof(uint16_t));
+  auto readWithRootValue = [&](uint64_t heuristic) {
+    std::string corrupt = snapshot;
+    memcpy(&corrupt[rootOffset], &heuristic, sizeof(heuristic));
+    std::stringstream in(corrupt);
+    return State::readSnapshot(in);
+  };
+  EXPECT_NE(readWithRootValue((uint64_t{3} << 32) | 5), nullptr);
+  EXPECT_NE(readWithRootValue(uint64_t{2} << 62), nullptr);
+  // More wins than trials.
+  EXPECT_EQ(readWithRootValue((uint64_t{6} << 32) | 5), nullptr);
+  // No trials.
+  EXPECT_EQ(readWithRootValue(0), nullptr);
+  // Solved, with counts.
+  EXPECT_EQ(readWithRootValue((uint64_t{2} << 62) | 5), nullptr);
+  // Not a solved tag.
+  EXPECT_EQ(readWithRootValue(uint64_t{1} << 62), nullptr);
+
+  // Trials recorded after a node was solved don't make the snapshot invalid.
+  root.getChild(3)->markSolvedState(Board::Player::Two);
+  for (int i = 0; i < 100; i++) {
+    root.getChild(3)->recordMonteCarloResult(Board::Player::Two);
+  }
+  std::stringstream solved;
+  root.writeSnapshot(solved);
+  auto loaded = State::readSnapshot(solved);
+  ASSERT_NE(loaded, nullptr);
+  EXPECT_EQ(loaded->getChild(3)->winProb().solvedWinner(), Board::Player::Two);
+}
+
+TEST(State, progressiveWidening) {
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  root.widen();
+  EXPECT_TRUE(root.hasChildren());
+  EXPECT_FALSE(root.fullyExpanded());
+  // The centre column is the most promising move on an empty board.
+  for (int col = 0; col < Board::kCols; col++) {
+    EXPECT_EQ(root.getChild(col) != nullptr, col == 3) << col;
+  }
+  EXPECT_FALSE(root.shouldWiden());
+
+  AI::thinkHard(&root, std::chrono::milliseconds(200));
+  int numChildren = 0;
+  for (int col = 0; col < Board::kCols; col++) {
+    numChildren += root.getChild(col) != nullptr;
+  }
+  EXPECT_GT(numChildren, 1);
+}
+
+TEST(State, widenBlocksFirst) {
+  Board b("       \n"
+          "       \n"
+          "       \n"
+          "       \n"
+          "       \n"
+          "XXX  OO\n");
+  State state(/*parent=*/nullptr, b, Board::Player::Two);
+  for (int col = 0; col < Board::kCols; col++) {
+    if (col != 3) {
+      EXPECT_GT(state.expansionPriority(3), state.expansionPriority(col));
+    }
+  }
+  state.widen();
+  EXPECT_NE(state.getChild(3), nullptr);
+}
+
+TEST(State, partiallyExpandedSolve) {
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  root.widen();
+
+  // Losing the only expanded move says nothing about the others...
+  root.getChild(3)->markSolvedState(Board::Player::Two);
+  EXPECT_EQ(root.winProb().solvedWinner(), Board::Player::None);
+  root.getChild(3)->updateProbabilities();
+  EXPECT_EQ(root.winProb().solvedWinner(), Board::Player::None);
+  // ...and the solved child has no trials, but the search must move on.
+  EXPECT_TRUE(root.shouldWiden());
+
+  // ...but one winning move is enough.
+  State other(/*parent=*/nullptr, Board(), Board::Player::One);
+  other.widen();
+  other.getChild(3)->markSolvedState(Board::Player::One);
+  EXPECT_EQ(other.winProb().solvedWinner(), Board::Player::One);
+}
+
+TEST(State, pickMoveSkipsFullColumn) {
+  Board b("X      \n"
+          "O      \n"
+          "X      \n"
+          "O      \n"
+          "X      \n"
+          "O      \n");
+  State state(/*parent=*/nullptr, b, Board::Player::One);
+  auto spot = state.pickMove();
+  EXPECT_NE(spot.col, 0);
+  EXPECT_EQ(spot.row, b.legalMoves().legalRowInCol[spot.col]);
+
+  // Expanded children that can't win don't make it pick a full column.
+  state.widen();
+  state.getChild(3)->markSolvedState(Board::Player::Two);
+  spot = state.pickMove();
+  EXPECT_NE(spot.col, 0);
+  EXPECT_NE(spot.col, 3);
+  EXPECT_EQ(spot.row, b.legalMoves().legalRowInCol[spot.col]);
+}
+
+TEST(AI, playsMoves) {
+  AI ai(/*aiPlayer=*/0, /*usecPerMove=*/50000);
+
+  // Discarded subtrees are freed in the background while play continues.
+  std::array<int, Board::kCols> heights{};
+  for (int i = 0; i < 3; i++) {
+    auto move = ai.waitForMove();
+    ASSERT_LT(move->col(), Board::kCols);
+    EXPECT_EQ(move->row(), heights[move->col()]++);
+
+    int col = (move->col() + 1) % Board::kCols;
+    game::Connect4::Move serverMove;
+    serverMove.set_row(heights[col]++);
+    serverMove.set_col(col);
+    ai.makeServerMove(serverMove);
+  }
+  EXPECT_FALSE(ai.gameIsOver());
+}
+
+TEST(Playout, forcedOutcomes) {
+  std::array<Board::Player, 20> winners;
+
+  // X to move completes the column.
+  Board win("       \n"
+            "       \n"
+            "       \n"
+            "X      \n"
+            "XO     \n"
+            "XOO    \n");
+  batchMonteCarloTrials(win, Board::Player::One, winners.size(),
+                        winners.data());
+  for (auto winner : winners) {
+    EXPECT_EQ(winner, Board::Player::One);
+  }
+
+  // O can't stop both ends of X's open three.
+  Board lose("       \n"
+             "       \n"
+             "       \n"
+             "       \n"
+             "   O   \n"
+             " XXX O \n");
+  batchMonteCarloTrials(lose, Board::Player::Two, winners.size(),
+                        winners.data());
+  for (auto winner : winners) {
+    EXPECT_EQ(winner, Board::Player::One);
+  }
+
+  Board finished(win);
+  finished.move(Board::Spot{.row = 3, .col = 0}, Board::Player::One);
+  batchMonteCarloTrials(finished, Board::Player::Two, winners.size(),
+                        winners.data());
+  for (auto winner : winners) {
+    EXPECT_EQ(winner, Board::Player::One);
+  }
+}
+
+TEST(Playout, matchesScalarPolicy) {
+  constexpr int kTrials = 4000;
+  std::vector<Board::Player> winners(kTrials);
+  batchMonteCarloTrials(Board(), Board::Player::One, kTrials, winners.data());
+
+  State state(/*parent=*/nullptr, Board(), Board::Player::One);
+  int batchWins = 0;
+  int scalarWins = 0;
+  for (int i = 0; i < kTrials; i++) {
+    EXPECT_NE(winners[i], Board::Player::None);
+    batchWins += winners[i] == Board::Player::One;
+    scalarWins += state.monteCarloTrial() == Board::Player::One;
+  }
+
+  // Both estimate the same probability; allow ~5 standard deviations.
+  EXPECT_NEAR(static_cast<double>(batchWins) / kTrials,
+              static_cast<double>(scalarWins) / kTrials, 0.06);
+}
+
+TEST(Playout, wideBoard) {
+  using Connect5 = BasicBoard<8, 9, 5>;
+  std::array<Board::Player, 2 * kPlayoutLanes + 3> winners;
+  batchMonteCarloTrials(Connect5(), Board::Player::One, winners.size(),
+                        winners.data());
+  for (auto winner : winners) {
+    EXPECT_NE(winner, Board::Player::None);
+  }
+  // 128-bit boards never get a SIMD kernel.
+  EXPECT_STREQ(batchPlayoutIsa<Connect5>(), "scalar");
+}
+
+TEST(Policy, threatPlayoutMakesThreats) {
+  // Only stacking a third X in column 0 makes a new threat.
+  Board b("       \n"
+          "       \n"
+          "       \n"
+          "       \n"
+          "X      \n"
+          "X    OO\n");
+  using Bits = Board::Bits;
+  Bits cur = b.board_[0];
+  Bits opp = b.board_[1];
+  Bits mask = cur | opp;
+  Bits possible = (mask + Board::kBottomMask) & Board::kBoardMask;
+  Bits oppWin = Board::winningCells(opp) & Board::kBoardMask & ~mask;
+
+  for (uint64_t seed = 1; seed <= 20; seed++) {
+    uint64_t rng = seed;
+    EXPECT_EQ(ThreatPlayout::pickMove<Board>(cur, opp, possible, /*myWin=*/0,
+                                             oppWin, &rng),
+              Bits{1} << 2);
+  }
+}
+
+TEST(Policy, uniformPlayoutFinishes) {
+  std::array<Board::Player, 4 * kPlayoutLanes> winners;
+  batchMonteCarloTrials<Board, UniformPlayout>(Board(), Board::Player::One,
+                                               winners.size(), winners.data());
+  BasicState<Board, UniformPolicy> state(/*parent=*/nullptr, Board(),
+                                         Board::Player::One);
+  for (auto winner : winners) {
+    EXPECT_NE(winner, Board::Player::None);
+    EXPECT_NE(state.monteCarloTrial(), Board::Player::None);
+  }
+}
+
+template <typename PolicyT> void expectFindsDoubleThreat() {
+  Board b("       \n"
+          "       \n"
+          "       \n"
+          "       \n"
+          "   OO  \n"
+          "   XX  \n");
+  BasicState<Board, PolicyT> root(/*parent=*/nullptr, b, Board::Player::One);
+  BasicAI<Board, PolicyT>::thinkHard(&root, std::chrono::milliseconds(300));
+  EXPECT_THAT(root.pickMove().col, testing::AnyOf(2, 5));
+}
+
+TEST(Policy, searchFindsDoubleThreat) {
+  expectFindsDoubleThreat<DefaultPolicy>();
+  expectFindsDoubleThreat<UniformPolicy>();
+  expectFindsDoubleThreat<ThreatPolicy>();
+  expectFindsDoubleThreat<SafeUcbPolicy>();
+}
+
+TEST(BoundedQueue, fifo) {
+  BoundedQueue<int> queue(/*capacity=*/3);
+  int value;
+  EXPECT_FALSE(queue.tryPop(&value));
+
+  // Rounded up to 4.
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(queue.tryPush(i));
+  }
+  EXPECT_FALSE(queue.tryPush(4));
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(queue.tryPop(&value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_FALSE(queue.tryPop(&value));
+}
+
+TEST(BoundedQueue, concurrent) {
+  constexpr int kPerThread = 10000;
+  BoundedQueue<int> queue(/*capacity=*/16);
+  std::atomic<int64_t> sum{0};
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.push_back(std::thread([&]() {
+      for (int i = 1; i <= kPerThread; i++) {
+        while (!queue.tryPush(i)) {
+          std::this_thread::yield();
+        }
+      }
+    }));
+    threads.push_back(std::thread([&]() {
+      int value;
+      for (int i = 0; i < kPerThread; i++) {
+        while (!queue.tryPop(&value)) {
+          std::this_thread::yield();
+        }
+        sum.fetch_add(value);
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(sum.load(), 2 * static_cast<int64_t>(kPerThread) *
+                            (kPerThread + 1) / 2);
+}
+
+TEST(AI, thinkPipelined) {
+  State root(/*parent=*/nullptr, Board(), Board::Player::One);
+  PipelineOptions options{.selectionThreads = 1,
+                          .simulationThreads = 2,
+                          .batchSize = 4,
+                          .queueDepth = 4};
+  auto stats = AI::thinkPipelined(&root, std::chrono::milliseconds(300),
+                                  options);
+
+  EXPECT_GT(stats.leavesSelected, 0);
+  EXPECT_GT(stats.playouts, 0);
+  EXPECT_GT(stats.leavesBackpropagated, 0);
+  EXPECT_TRUE(root.hasChildren());
+
+  // Every scheduled playout was either backpropagated or released.
+  EXPECT_EQ(root.virtualLoss(), 0);
+  for (int col = 0; col < Board::kCols; col++) {
+    EXPECT_EQ(root.getChild(col)->virtualLoss(), 0);
+  }
+}
+
+// The outcome for the player to move under perfect play: 1 win, 0 draw, -1
+// loss.
+template <typename BoardT>
+int negamax(const BoardT &board, BoardBase::Player playerToMove) {
+  auto legalMoves = board.legalMoves();
+  int best = -2;
+  for (int col = 0; col < BoardT::kCols; col++) {
+    int row = legalMoves.legalRowInCol[col];
+    if (row == BoardT::LegalMoves::kIllegal) {
+      continue;
+    }
+    BoardT next(board);
+    next.move(BoardBase::Spot{.row = row, .col = col}, playerToMove);
+    int value = next.winner() == playerToMove
+                    ? 1
+                    : -negamax(next, BoardT::other(playerToMove));
+    best = std::max(best, value);
+  }
+  return best == -2 ? 0 : best;
+}
+
+TEST(Proof, doubleThreat) {
+  Board b("       \n"
+          "       \n"
+          "       \n"
+          "       \n"
+          "   OO  \n"
+          "   XX  \n");
+  DfpnSolver<Board> solver(/*tableBits=*/16);
+  auto deadline = DfpnSolver<Board>::Clock::time_point::max();
+
+  int winningCol = -1;
+  EXPECT_EQ(solver.solve(b, Board::Player::One, Board::Player::One,
+                         /*maxNodes=*/100000, deadline, &winningCol),
+            DfpnSolver<Board>::Result::kProved);
+  EXPECT_THAT(winningCol, testing::AnyOf(2, 5));
+  EXPECT_EQ(solver.solve(b, Board::Player::One, Board::Player::Two,
+                         /*maxNodes=*/100000, deadline),
+            DfpnSolver<Board>::Result::kDisproved);
+}
+
+TEST(Proof, matchesNegamax) {
+  using SmallBoard = BasicBoard<5, 4, 4>;
+  using Solver = DfpnSolver<SmallBoard>;
+  Solver solver(/*tableBits=*/16);
+  auto deadline = Solver::Clock::time_point::max();
+
+  std::mt19937 gen(7);
+  int positions = 0;
+  int decided = 0;
+  while (positions < 30) {
+    // Random games, cut off 10 moves before the board fills.
+    SmallBoard b;
+    auto player = BoardBase::Player::One;
+    for (int stones = 0; stones < 10 && b.winner() == BoardBase::Player::None;
+         stones++) {
+      auto legalMoves = b.legalMoves();
+      int col;
+      do {
+        col = gen() % SmallBoard::kCols;
+      } while (legalMoves.legalRowInCol[col] ==
+               SmallBoard::LegalMoves::kIllegal);
+      b.move(BoardBase::Spot{.row = legalMoves.legalRowInCol[col], .col = col},
+             player);
+      player = SmallBoard::other(player);
+    }
+    if (b.winner() != BoardBase::Player::None) {
+      continue;
+    }
+    positions++;
+
+    int value = negamax(b, player);
+    auto win = solver.solve(b, player, player, /*maxNodes=*/1000000, deadline);
+    auto loss = solver.solve(b, player, SmallBoard::other(player),
+                             /*maxNodes=*/1000000, deadline);
+    EXPECT_EQ(win, value == 1 ? Solver::Result::kProved
+                              : Solver::Result::kDisproved)
+        << b.debugString();
+    EXPECT_EQ(loss, value == -1 ? Solver::Result::kProved
+                                : Solver::Result::kDisproved)
+        << b.debugString();
+    decided += value != 0;
+  }
+  // Not just a table of draws.
+  EXPECT_GT(decided, 0);
+}
+
+TEST(AI, proveHard) {
+  Board b("       \n"
+          "       \n"
+          "       \n"
+          "       \n"
+          "   OO  \n"
+          "   XX  \n");
+  State root(/*parent=*/nullptr, b, Board::Player::One);
+  root.createChildren();
+
+  auto stats = AI::proveHard(&root, std::chrono::seconds(10),
+                             ProofSearchOptions{});
+  EXPECT_EQ(root.winProb().solvedWinner(), Board::Player::One);
+  EXPECT_GT(stats.proofs, 0);
+  EXPECT_THAT(root.pickMove().col, testing::AnyOf(2, 5));
+}
+
+TEST(AI, proofSurvivesSearch) {
+  Board b;
+  b.board_ = kNarrowWinPositions[0];
+  auto mover = b.nextPlayer();
+  State root(/*parent=*/nullptr, b, mover);
+  root.createChildren();
+
+  // Marked the way proveHard marks a proved loss.
+  DfpnSolver<Board> solver(/*tableBits=*/22);
+  State *proved = nullptr;
+  for (int col = 0; col < Board::kCols && !proved; col++) {
+    auto *child = root.getChild(col);
+    if (child && solver.solve(child->board(), Board::other(mover), mover,
+                              /*maxNodes=*/1 << 24,
+                              DfpnSolver<Board>::Clock::time_point::max()) ==
+                     DfpnSolver<Board>::Result::kProved) {
+      proved = child;
+    }
+  }
+  ASSERT_NE(proved, nullptr);
+  // proveHard's targets have been expanded by the search already.
+  proved->createChildren();
+  proved->markSolvedState(mover);
+  ASSERT_EQ(root.winProb().solvedWinner(), mover);
+
+  // Searches below the proved state, like one that picked its leaf before
+  // the proof, leave the proof alone.
+  int searched = 0;
+  for (int col = 0; col < Board::kCols; col++) {
+    auto *child = proved->getChild(col);
+    if (child && child->winProb().solvedWinner() == Board::Player::None) {
+      EXPECT_GT(AI::thinkHard(child, std::chrono::seconds(10),
+                              /*maxPlayouts=*/1000),
+                0);
+      searched++;
+    }
+  }
+  EXPECT_GT(searched, 0);
+  EXPECT_EQ(proved->winProb().solvedWinner(), mover);
+  EXPECT_EQ(root.winProb().solvedWinner(), mover);
+}
+
+TEST(NodePool, reusesBlocks) {
+  NodePool pool(100, NodePoolOptions{.hugePages = false});
+  std::set<void *> blocks;
+  for (int i = 0; i < 50000; i++) {
+    void *block = pool.allocate();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % 64, 0);
+    EXPECT_TRUE(blocks.insert(block).second);
+  }
+  // 50000 128-byte blocks don't fit in one 2MB chunk.
+  EXPECT_GT(pool.stats().chunks, 1);
+  EXPECT_EQ(pool.stats().blocksInUse, 50000);
+
+  void *freed = *blocks.begin();
+  pool.deallocate(freed);
+  EXPECT_EQ(pool.stats().blocksInUse, 49999);
+  EXPECT_EQ(pool.allocate(), freed);
+}
+
+TEST(NodePool, threadCachesDrainOnExit) {
+  NodePool pool(100, NodePoolOptions{.hugePages = false});
+  // 20000 128-byte blocks need two chunks, with less than 20000 blocks left
+  // in the second.
+  std::vector<void *> blocks(20000);
+  std::thread([&] {
+    for (auto &block : blocks) {
+      block = pool.allocate();
+    }
+  }).join();
+  std::thread([&] {
+    for (auto *block : blocks) {
+      pool.deallocate(block);
+    }
+  }).join();
+  EXPECT_EQ(pool.stats().blocksInUse, 0);
+  auto chunks = pool.stats().chunks;
+
+  // The threads gave their cached blocks back when they exited.
+  for (auto &block : blocks) {
+    block = pool.allocate();
+  }
+  EXPECT_EQ(pool.stats().chunks, chunks);
+  EXPECT_EQ(pool.stats().blocksInUse, blocks.size());
+}
+
+TEST(NodePool, holdsStates) {
+  EXPECT_GE(NumaTopology::get().numNodes(), 1);
+  EXPECT_LT(NumaTopology::get().currentNode(), NumaTopology::get().numNodes());
+
+  auto before = State::nodePool().stats().blocksInUse;
+  {
+    auto root = std::make_unique<State>(/*parent=*/nullptr, Board(),
+                                        Board::Player::One);
+    root->createChildren();
+    EXPECT_EQ(State::nodePool().stats().blocksInUse, before + 1 + 7);
+  }
+  EXPECT_EQ(State::nodePool().stats().blocksInUse, before);
+}
+
 } // namespace ais::conn4
@@ -0,0 +1,29 @@
+#include "ais/connect4Distributed.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+// Usage: connect4Worker [port] [numThreads]
+int main(int argc, char **argv) {
+  std::string port = argc > 1 ? argv[1] : "50052";
+  int numThreads =
+      argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+
+  ais::conn4::SearchWorker worker(numThreads);
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort("0.0.0.0:" + port,
+                           grpc::InsecureServerCredentials());
+  builder.RegisterService(&worker);
+  auto server = builder.BuildAndStart();
+  if (!server) {
+    fprintf(stderr, "Failed to listen on port %s\n", port.c_str());
+    return 1;
+  }
+
+  printf("Search worker listening on port %s with %d threads\n", port.c_str(),
+         numThreads);
+  server->Wait();
+  return 0;
+}
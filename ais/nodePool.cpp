@@ -0,0 +1,359 @@
+#include "ais/nodePool.h"
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+
+namespace ais {
+
+namespace {
+
+// Parses a sysfs list such as "0-3,8-11".
+bool parseCpuList(const std::string &path, std::vector<int> *values) {
+  std::ifstream in(path);
+  std::string list;
+  if (!std::getline(in, list)) {
+    return false;
+  }
+
+  std::stringstream ranges(list);
+  for (std::string range; std::getline(ranges, range, ',');) {
+    int first, last;
+    char dash;
+    std::stringstream parts(range);
+    if (!(parts >> first)) {
+      return false;
+    }
+    last = (parts >> dash >> last) ? last : first;
+    for (int value = first; value <= last; value++) {
+      values->push_back(value);
+    }
+  }
+  return true;
+}
+
+constexpr int kMaxNodes = 1024;
+
+// The ids of the live pools. Leaked, so that threads exiting during static
+// destruction can still check it.
+struct PoolRegistry {
+  std::mutex mutex;
+  std::unordered_set<uint64_t> live;
+  uint64_t nextId{1};
+};
+
+PoolRegistry &poolRegistry() {
+  static auto *registry = new PoolRegistry;
+  return *registry;
+}
+
+uint64_t registerPool() {
+  auto &registry = poolRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  uint64_t id = registry.nextId++;
+  registry.live.insert(id);
+  return id;
+}
+
+int counterShardIdx() {
+  static std::atomic<int> nextIdx{0};
+  thread_local int idx = nextIdx.fetch_add(1, std::memory_order_relaxed);
+  return idx;
+}
+
+} // namespace
+
+// Free blocks that all belong to the arena of `node`.
+struct NodePool::ThreadCache {
+  NodePool *pool;
+  uint64_t poolId;
+  int node;
+  int size;
+  FreeBlock *blocks;
+};
+
+struct NodePool::ThreadCaches {
+  ~ThreadCaches() {
+    // Holding the registry lock keeps the pools from being destroyed
+    // meanwhile.
+    auto &registry = poolRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto &cache : caches) {
+      if (cache.size > 0 && registry.live.count(cache.poolId)) {
+        cache.pool->drain(&cache, cache.size);
+      }
+    }
+  }
+
+  std::vector<ThreadCache> caches;
+};
+
+NumaTopology::NumaTopology() {
+  std::vector<int> nodes;
+  if (parseCpuList("/sys/devices/system/node/online", &nodes) &&
+      !nodes.empty() && nodes.back() < kMaxNodes) {
+    cpusOfNode_.resize(nodes.back() + 1);
+    for (int node : nodes) {
+      parseCpuList("/sys/devices/system/node/node" + std::to_string(node) +
+                       "/cpulist",
+                   &cpusOfNode_[node]);
+      for (int cpu : cpusOfNode_[node]) {
+        if (cpu >= static_cast<int>(nodeOfCpu_.size())) {
+          nodeOfCpu_.resize(cpu + 1, 0);
+        }
+        nodeOfCpu_[cpu] = node;
+      }
+    }
+  }
+  if (cpusOfNode_.empty()) {
+    cpusOfNode_.resize(1);
+  }
+}
+
+const NumaTopology &NumaTopology::get() {
+  static const NumaTopology topology;
+  return topology;
+}
+
+int NumaTopology::currentNode() const {
+  int cpu = sched_getcpu();
+  return cpu >= 0 && cpu < static_cast<int>(nodeOfCpu_.size())
+             ? nodeOfCpu_[cpu]
+             : 0;
+}
+
+bool NumaTopology::bindThreadToNode(int node) const {
+  if (numNodes() <= 1 || node < 0 || node >= numNodes() ||
+      cpusOfNode_[node].empty()) {
+    return false;
+  }
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int cpu : cpusOfNode_[node]) {
+    CPU_SET(cpu, &cpus);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
+NodePool::NodePool(size_t blockSize, NodePoolOptions options)
+    : id_(registerPool()),
+      // Whole cache lines, so that blocks handed to different threads don't
+      // share one.
+      blockSize_((std::max(blockSize, sizeof(FreeBlock)) + 63) / 64 * 64),
+      options_(options),
+      numNodes_(options.numaLocal ? NumaTopology::get().numNodes() : 1),
+      arenas_(std::make_unique<Arena[]>(numNodes_)),
+      counterShards_(std::make_unique<CounterShard[]>(kNumCounterShards)) {
+  assert(blockSize_ <= kChunkSize - sizeof(ChunkHeader));
+}
+
+NodePool::~NodePool() {
+  // Blocks still cached by threads are dropped with the chunks. The threads
+  // forget their caches the next time they look for another pool's.
+  {
+    auto &registry = poolRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.live.erase(id_);
+  }
+  for (int node = 0; node < numNodes_; node++) {
+    for (void *chunk : arenas_[node].chunks) {
+      munmap(chunk, kChunkSize);
+    }
+  }
+}
+
+char *NodePool::mapChunk(int node) {
+  void *chunk = MAP_FAILED;
+  if (options_.hugePages) {
+    chunk = mmap(nullptr, kChunkSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (chunk != MAP_FAILED) {
+      explicitHugeChunks_++;
+    }
+  }
+
+  if (chunk == MAP_FAILED) {
+    // No reserved huge pages. Over-map so the chunk can be aligned to a huge
+    // page boundary, which transparent huge pages need.
+    void *region = mmap(nullptr, 2 * kChunkSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+      return nullptr;
+    }
+    auto start = reinterpret_cast<uintptr_t>(region);
+    auto aligned = (start + kChunkSize - 1) & ~(kChunkSize - 1);
+    if (aligned > start) {
+      munmap(region, aligned - start);
+    }
+    munmap(reinterpret_cast<void *>(aligned + kChunkSize),
+           start + kChunkSize - aligned);
+    chunk = reinterpret_cast<void *>(aligned);
+    madvise(chunk, kChunkSize,
+            options_.hugePages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+  }
+
+  // Before the first touch, which is what places the pages. Preferred rather
+  // than bound, so a full node spills over instead of failing.
+  if (numNodes_ > 1) {
+    unsigned long mask[kMaxNodes / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] |=
+        1UL << (node % (8 * sizeof(unsigned long)));
+    syscall(SYS_mbind, chunk, kChunkSize, MPOL_PREFERRED, mask, kMaxNodes, 0);
+  }
+
+  new (chunk) ChunkHeader{.node = node};
+  chunks_++;
+  return static_cast<char *>(chunk);
+}
+
+NodePool::ThreadCache &NodePool::threadCache() {
+  static thread_local ThreadCaches threadCaches;
+  auto &caches = threadCaches.caches;
+  for (auto &cache : caches) {
+    if (cache.poolId == id_) {
+      return cache;
+    }
+  }
+
+  // The first call for this pool on this thread. Forget the caches of
+  // destroyed pools while at it.
+  {
+    auto &registry = poolRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::erase_if(caches, [&](const ThreadCache &cache) {
+      return !registry.live.count(cache.poolId);
+    });
+  }
+  caches.push_back(ThreadCache{
+      .pool = this, .poolId = id_, .node = 0, .size = 0, .blocks = nullptr});
+  return caches.back();
+}
+
+void NodePool::refill(ThreadCache *cache) {
+  auto &arena = arenas_[cache->node];
+
+  std::lock_guard<std::mutex> lock(arena.mutex);
+  while (cache->size < kCacheBatch) {
+    FreeBlock *block;
+    if (arena.freeList) {
+      block = arena.freeList;
+      arena.freeList = arena.freeList->next;
+    } else if (arena.next + blockSize_ <= arena.end) {
+      block = reinterpret_cast<FreeBlock *>(arena.next);
+      arena.next += blockSize_;
+    } else if (cache->size > 0) {
+      // Don't map a chunk until the blocks at hand are used up.
+      break;
+    } else {
+      char *chunk = mapChunk(cache->node);
+      if (!chunk) {
+        throw std::bad_alloc();
+      }
+      arena.chunks.push_back(chunk);
+      arena.next = chunk + sizeof(ChunkHeader);
+      arena.end = chunk + kChunkSize;
+      continue;
+    }
+    block->next = cache->blocks;
+    cache->blocks = block;
+    cache->size++;
+  }
+}
+
+void NodePool::drain(ThreadCache *cache, int numBlocks) {
+  if (numBlocks == 0) {
+    return;
+  }
+  FreeBlock *first = cache->blocks;
+  FreeBlock *last = first;
+  for (int i = 1; i < numBlocks; i++) {
+    last = last->next;
+  }
+  cache->blocks = last->next;
+  cache->size -= numBlocks;
+
+  auto &arena = arenas_[cache->node];
+  std::lock_guard<std::mutex> lock(arena.mutex);
+  last->next = arena.freeList;
+  arena.freeList = first;
+}
+
+void *NodePool::allocate() {
+  auto &cache = threadCache();
+  if (numNodes_ > 1) {
+    // The thread moved to another node. Give its blocks back to their arena
+    // and cache local ones from now on.
+    int node = NumaTopology::get().currentNode();
+    if (node != cache.node) {
+      drain(&cache, cache.size);
+      cache.node = node;
+    }
+  }
+  if (!cache.blocks) {
+    refill(&cache);
+  }
+
+  FreeBlock *block = cache.blocks;
+  cache.blocks = block->next;
+  cache.size--;
+  counterShards_[counterShardIdx() % kNumCounterShards].blocksInUse.fetch_add(
+      1, std::memory_order_relaxed);
+  return block;
+}
+
+void NodePool::deallocate(void *block) {
+  if (!block) {
+    return;
+  }
+  counterShards_[counterShardIdx() % kNumCounterShards].blocksInUse.fetch_sub(
+      1, std::memory_order_relaxed);
+
+  auto *header = reinterpret_cast<ChunkHeader *>(
+      reinterpret_cast<uintptr_t>(block) & ~(kChunkSize - 1));
+  auto *freeBlock = static_cast<FreeBlock *>(block);
+  auto &cache = threadCache();
+  if (header->node != cache.node) {
+    // Allocated on another node. Straight back to its own arena, so that
+    // the cache only ever hands out local blocks.
+    auto &arena = arenas_[header->node];
+    std::lock_guard<std::mutex> lock(arena.mutex);
+    freeBlock->next = arena.freeList;
+    arena.freeList = freeBlock;
+    return;
+  }
+
+  freeBlock->next = cache.blocks;
+  cache.blocks = freeBlock;
+  cache.size++;
+  // Keep a batch after draining, so that alternating allocations and frees
+  // don't go to the arena every time.
+  if (cache.size >= 2 * kCacheBatch) {
+    drain(&cache, kCacheBatch);
+  }
+}
+
+NodePoolStats NodePool::stats() const {
+  int64_t blocksInUse = 0;
+  for (int i = 0; i < kNumCounterShards; i++) {
+    blocksInUse += counterShards_[i].blocksInUse.load();
+  }
+  return NodePoolStats{.chunks = chunks_.load(),
+                       .explicitHugeChunks = explicitHugeChunks_.load(),
+                       .blocksInUse = static_cast<uint64_t>(blocksInUse),
+                       .numNodes = numNodes_};
+}
+
+} // namespace ais
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ais {
+
+// The machine's NUMA nodes and their CPUs, read once from sysfs. Without
+// NUMA information (or with a single node) everything is node 0 and the
+// thread binding below does nothing.
+class NumaTopology {
+public:
+  static const NumaTopology &get();
+
+  int numNodes() const { return cpusOfNode_.size(); }
+
+  // The node of the CPU the calling thread is running on.
+  int currentNode() const;
+
+  // Restricts the calling thread to the CPUs of `node`. Returns false, and
+  // leaves the thread alone, on a single-node machine or if that fails.
+  bool bindThreadToNode(int node) const;
+
+private:
+  NumaTopology();
+
+  std::vector<std::vector<int>> cpusOfNode_;
+  std::vector<int> nodeOfCpu_;
+};
+
+struct NodePoolOptions {
+  bool hugePages{true};
+  // Place chunks on the allocating thread's node. Off, every block comes from
+  // one arena wherever the kernel puts it.
+  bool numaLocal{true};
+};
+
+struct NodePoolStats {
+  uint64_t chunks{0};
+  // Chunks backed by explicit (hugetlbfs) huge pages; the rest are advised for
+  // transparent ones when NodePoolOptions::hugePages is set.
+  uint64_t explicitHugeChunks{0};
+  uint64_t blocksInUse{0};
+  int numNodes{1};
+};
+
+// Fixed-size blocks carved out of 2MB chunks, with one arena of chunks per
+// NUMA node. A block is allocated from the arena of the calling thread's
+// node, and freed back to the arena it came from, so nodes created by threads
+// on one socket stay in that socket's memory. Chunks are backed by huge
+// pages: explicit ones when the system has them reserved, transparent ones
+// otherwise. Chunks are only unmapped when the pool is destroyed.
+//
+// Each thread keeps a cache of free blocks from its node's arena, refilled
+// from and drained to the arena kCacheBatch blocks at a time, so most calls
+// don't take an arena lock. A thread's cache goes back to the arena when the
+// thread exits.
+class NodePool {
+public:
+  static constexpr size_t kChunkSize = size_t{2} << 20;
+  static constexpr int kCacheBatch = 32;
+
+  explicit NodePool(size_t blockSize,
+                    NodePoolOptions options = NodePoolOptions{});
+  ~NodePool();
+
+  NodePool(const NodePool &) = delete;
+  NodePool &operator=(const NodePool &) = delete;
+
+  void *allocate();
+  void deallocate(void *block);
+
+  NodePoolStats stats() const;
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  // At the start of every chunk, so a block can find its arena.
+  struct alignas(64) ChunkHeader {
+    int node;
+  };
+
+  struct alignas(64) Arena {
+    std::mutex mutex;
+    FreeBlock *freeList{nullptr};
+    char *next{nullptr};
+    char *end{nullptr};
+    std::vector<void *> chunks;
+  };
+
+  // Defined in nodePool.cpp.
+  struct ThreadCache;
+  struct ThreadCaches;
+
+  static constexpr int kNumCounterShards = 64;
+
+  // Threads count their allocations in their own cache line, which stats()
+  // adds up.
+  struct alignas(64) CounterShard {
+    std::atomic<int64_t> blocksInUse{0};
+  };
+
+  // Maps a chunk placed on `node`, or returns nullptr.
+  char *mapChunk(int node);
+
+  // The calling thread's cache for this pool.
+  ThreadCache &threadCache();
+  // Moves up to kCacheBatch blocks from the cache's arena into the cache.
+  void refill(ThreadCache *cache);
+  // Moves `numBlocks` blocks from the cache back to its arena.
+  void drain(ThreadCache *cache, int numBlocks);
+
+  // Never reused, so a thread's cache for a destroyed pool can't be mistaken
+  // for a cache of a new pool at the same address.
+  const uint64_t id_;
+  const size_t blockSize_;
+  const NodePoolOptions options_;
+  const int numNodes_;
+  std::unique_ptr<Arena[]> arenas_;
+  std::atomic<uint64_t> chunks_{0};
+  std::atomic<uint64_t> explicitHugeChunks_{0};
+  std::unique_ptr<CounterShard[]> counterShards_;
+};
+
+} // namespace ais
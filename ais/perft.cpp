@@ -0,0 +1,40 @@
+#include "ais/connect4Perft.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Usage: perft <depth> [numThreads] [--tt]
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <depth> [numThreads] [--tt]\n", argv[0]);
+    return 1;
+  }
+
+  int maxDepth = atoi(argv[1]);
+  ais::conn4::PerftOptions options;
+  options.numThreads = std::thread::hardware_concurrency();
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--tt") == 0) {
+      options.transpositions = true;
+    } else {
+      options.numThreads = atoi(argv[i]);
+    }
+  }
+
+  printf("threads: %d, transpositions: %s\n", options.numThreads,
+         options.transpositions ? "on" : "off");
+  for (int depth = 1; depth <= maxDepth; depth++) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = ais::conn4::perft(ais::conn4::Board(), depth, options);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf("depth %2d: %14llu nodes %9.3fs %10.2f Mnodes/s\n", depth,
+           static_cast<unsigned long long>(nodes), elapsed.count(),
+           nodes / elapsed.count() / 1e6);
+  }
+
+  return 0;
+}
@@ -0,0 +1,160 @@
+#include "ais/connect4GameLog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ais::conn4::AI;
+using ais::conn4::Board;
+using ais::conn4::GameLogRecord;
+
+const char *playerName(uint8_t player) {
+  return player == static_cast<uint8_t>(Board::Player::One) ? "X" : "O";
+}
+
+void dump(const GameLogRecord &record) {
+  printf("game %llu move %2d %s col %d%s",
+         static_cast<unsigned long long>(record.gameId), record.moveNum,
+         playerName(record.player), record.col, record.byAI ? " ai" : "   ");
+  if (record.byAI) {
+    printf(" %8.1fms %10llu playouts  probs", record.usecThink / 1e3,
+           static_cast<unsigned long long>(record.playouts));
+    for (int col = 0; col < Board::kCols; col++) {
+      if (std::isnan(record.colProbs[col])) {
+        printf("    - ");
+      } else {
+        printf(" %.3f", record.colProbs[col]);
+      }
+    }
+  }
+  if (record.winner != static_cast<uint8_t>(Board::Player::None)) {
+    printf("  game over");
+  }
+  printf("\n");
+}
+
+} // namespace
+
+// Usage: replay <log> [--usec=N] [--playouts=N] [--threads=N] [--game=ID]
+//               [--dump]
+//
+// Searches every position in the log again, the way the AI does, under a
+// fixed budget per position and compares the move choices and search speed
+// with what was logged. --dump prints the log instead.
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <log> [--usec=N] [--playouts=N] [--threads=N] "
+            "[--game=ID] [--dump]\n",
+            argv[0]);
+    return 1;
+  }
+
+  auto budget = AI::Clock::duration(std::chrono::seconds(1));
+  uint64_t maxPlayouts = 0;
+  int numThreads = std::thread::hardware_concurrency();
+  uint64_t gameId = 0;
+  bool dumpOnly = false;
+  for (int i = 2; i < argc; i++) {
+    if (strncmp(argv[i], "--usec=", 7) == 0) {
+      budget = std::chrono::microseconds(atoll(argv[i] + 7));
+    } else if (strncmp(argv[i], "--playouts=", 11) == 0) {
+      // Per thread, like thinkHard's limit.
+      maxPlayouts = strtoull(argv[i] + 11, nullptr, 10);
+    } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+      numThreads = std::max(atoi(argv[i] + 10), 1);
+    } else if (strncmp(argv[i], "--game=", 7) == 0) {
+      gameId = strtoull(argv[i] + 7, nullptr, 10);
+    } else if (strcmp(argv[i], "--dump") == 0) {
+      dumpOnly = true;
+    }
+  }
+
+  ais::conn4::MappedGameLog log(argv[1]);
+  if (!log.ok()) {
+    fprintf(stderr, "%s is not a game log\n", argv[1]);
+    return 1;
+  }
+
+  int replayed = 0;
+  int aiMoves = 0;
+  int sameMoves = 0;
+  double loggedSeconds = 0.0;
+  double replaySeconds = 0.0;
+  uint64_t loggedPlayouts = 0;
+  uint64_t replayPlayouts = 0;
+  for (const auto &record : log.records()) {
+    if (!record.valid() ||
+        (gameId != 0 && record.gameId != gameId)) {
+      continue;
+    }
+    if (dumpOnly) {
+      dump(record);
+      continue;
+    }
+
+    Board board;
+    board.board_ = {record.board[0], record.board[1]};
+    auto player = static_cast<Board::Player>(record.player);
+    if (!board.boardIsLegal() || board.winner() != Board::Player::None) {
+      continue;
+    }
+
+    auto start = AI::Clock::now();
+    ais::conn4::State root(/*parent=*/nullptr, board, player);
+    std::atomic<uint64_t> playouts{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+      threads.push_back(std::thread(
+          [&]() { playouts += AI::thinkHard(&root, budget, maxPlayouts); }));
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    // The same choice the AI makes after thinking.
+    int col = root.pickMove(/*printStats=*/false).col;
+    std::chrono::duration<double> elapsed = AI::Clock::now() - start;
+
+    replayed++;
+    replaySeconds += elapsed.count();
+    replayPlayouts += playouts;
+    printf("game %llu move %2d %s: logged col %d%s, replay col %d in %.1fms "
+           "with %llu playouts",
+           static_cast<unsigned long long>(record.gameId), record.moveNum,
+           playerName(record.player), record.col, record.byAI ? " (ai)" : "",
+           col, elapsed.count() * 1e3,
+           static_cast<unsigned long long>(playouts.load()));
+    if (record.byAI) {
+      aiMoves++;
+      sameMoves += col == record.col;
+      loggedSeconds += record.usecThink / 1e6;
+      loggedPlayouts += record.playouts;
+      printf(", logged %.1fms with %llu playouts%s", record.usecThink / 1e3,
+             static_cast<unsigned long long>(record.playouts),
+             col == record.col ? "" : "  DIFFERENT");
+    }
+    printf("\n");
+  }
+
+  if (!dumpOnly) {
+    printf("replayed %d positions: %.1fms and %.0f playouts/s on average\n",
+           replayed, replayed ? replaySeconds / replayed * 1e3 : 0.0,
+           replaySeconds > 0.0 ? replayPlayouts / replaySeconds : 0.0);
+    if (aiMoves > 0) {
+      printf("logged AI moves: %d, same choice on replay: %d (%.0f%%), "
+             "logged %.1fms and %.0f playouts/s on average\n",
+             aiMoves, sameMoves, 100.0 * sameMoves / aiMoves,
+             loggedSeconds / aiMoves * 1e3,
+             loggedSeconds > 0.0 ? loggedPlayouts / loggedSeconds : 0.0);
+    }
+  }
+  return 0;
+}